@@ -24,15 +24,52 @@ struct command_t {
     std::vector<branch_t> branches;
 };
 
+// `formula name = value;`; expressions read `value` through `name`, so a
+// value is written once however many expressions share it
+struct formula_t {
+    std::string name;
+    ptr<expr_t> value;
+};
+
+// indices of `mdp_t::commands` keyed by the `k` of their `location=k` guard
+struct command_index_t {
+    std::unordered_map<int, std::vector<size_t>> by_location;
+    // commands whose guard does not fix `location`, enabled anywhere
+    std::vector<size_t> unlocated;
+};
+
+// positions of declarations by name. Declarations appended since the
+// last lookup are indexed lazily, and a stale index (e.g. after the
+// declarations were reordered) is rebuilt.
+struct name_index_t {
+    std::unordered_map<std::string, size_t> position;
+    size_t indexed = 0;
+};
+
 struct mdp_t {
     std::string module_name;
     std::vector<variable_t> variables;
     std::vector<constant_t> constants;
     std::vector<command_t> commands;
+    std::vector<formula_t> formulas = {};
+    // maintained by `merge`
+    name_index_t variable_index = {}, constant_index = {};
 
+    // the union of both; the smaller side is moved into the larger one, so
+    // the order of declarations and commands is unspecified
     static mdp_t merge(mdp_t&& lhs, mdp_t&& rhs);
+    command_index_t index_commands() const;
 };
 
+// `k` if the guard is `location=k` or a conjunction containing it
+util::optional<int> guard_location(expr_t const&);
+
+// whether no two commands are ever enabled together, as shown by the
+// guards of the commands at the same location: one of them has a
+// conjunct that negates one of the other, or both compare a variable
+// with different constants. Such a model is a DTMC.
+bool is_deterministic(mdp_t const&);
+
 std::ostream& operator<<(std::ostream&, command_t const&);
 std::ostream& operator<<(std::ostream&, mdp_t const&);
 
@@ -10,6 +10,8 @@ namespace pctl {
 struct pctl_t {
     int final_location;
     ptr<logic::formula_t> constraint;
+    bool deterministic; // of the model, queried without Pmin/Pmax
+    util::optional<int> overflow_location; // of the stacks of recursive functions
 
     void output(std::ostream&) const;
 };
@@ -0,0 +1,137 @@
+#ifndef PML_BDD_HPP
+#define PML_BDD_HPP
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+// a small MTBDD package: BDDs are MTBDDs with terminals 0 and 1.
+// Nodes are hash-consed in a unique table, operations are memoized in a
+// direct-mapped computed table, and nodes unreachable from a live
+// `mtbdd_t` are reclaimed by mark-and-sweep garbage collection.
+namespace bdd {
+
+using node_id = std::uint32_t;
+
+enum class op_t : std::uint8_t {
+    Add, Sub, Mul, Div, Min, Max, Pow, Mod, Log,
+    Lt, Leq, Geq, Gt, Eq, Neq, And, Or, Iff, Impl,
+    Not, Floor, Ceil
+};
+
+struct manager_t;
+
+// reference-counted handle to a node
+struct mtbdd_t {
+    mtbdd_t() = default;
+    mtbdd_t(manager_t* manager, node_id id);
+    mtbdd_t(mtbdd_t const&);
+    mtbdd_t(mtbdd_t&&) noexcept;
+    mtbdd_t& operator=(mtbdd_t const&);
+    mtbdd_t& operator=(mtbdd_t&&) noexcept;
+    ~mtbdd_t();
+
+    node_id id() const {
+        return node;
+    }
+    bool operator==(mtbdd_t const& other) const {
+        return node == other.node;
+    }
+    bool operator!=(mtbdd_t const& other) const {
+        return node != other.node;
+    }
+private:
+    manager_t* manager = nullptr;
+    node_id node = 0;
+};
+
+struct manager_t {
+    explicit manager_t(size_t cache_size = 1 << 18);
+    manager_t(manager_t const&) = delete;
+    manager_t& operator=(manager_t const&) = delete;
+
+    mtbdd_t constant(double);
+    // 1 where the variable at `level` is set, 0 elsewhere
+    mtbdd_t variable(std::uint32_t level);
+
+    mtbdd_t apply(op_t, mtbdd_t const&, mtbdd_t const&);
+    mtbdd_t apply(op_t, mtbdd_t const&);
+    // `f` is a BDD
+    mtbdd_t ite(mtbdd_t const& f, mtbdd_t const& g, mtbdd_t const& h);
+    // abstracts the variables of `cube` by Add, Min or Max
+    mtbdd_t abstract(op_t, mtbdd_t const& f, mtbdd_t const& cube);
+    mtbdd_t cube(std::vector<std::uint32_t> levels);
+    // moves every level by `delta`, which keeps the order of the levels of `f`
+    mtbdd_t shift(mtbdd_t const& f, std::int32_t delta);
+
+    double value(mtbdd_t const& terminal) const;
+    bool is_constant(mtbdd_t const&) const;
+    double min_value(mtbdd_t const&) const;
+    double max_value(mtbdd_t const&) const;
+    // follows `assignment[level]` from the root
+    double eval(mtbdd_t const&, std::vector<bool> const& assignment) const;
+
+    // whether arithmetic on terminals was ever rounded; sticky
+    bool inexact = false;
+
+    size_t live_nodes() const {
+        return nodes.size() - free.size();
+    }
+    void collect_garbage();
+
+private:
+    friend struct mtbdd_t;
+
+    struct node_t {
+        std::uint32_t level;
+        node_id low, high;
+        double value;
+        node_id next; // chain of the unique table
+        std::uint32_t refs;
+        bool marked;
+    };
+    struct cache_entry_t {
+        std::uint8_t op;
+        node_id f, g, h;
+        node_id result;
+        bool valid;
+    };
+
+    static constexpr std::uint32_t terminal_level = UINT32_MAX;
+    static constexpr node_id nil = UINT32_MAX;
+
+    std::vector<node_t> nodes;
+    std::vector<node_id> free;
+    std::vector<node_id> buckets;
+    std::vector<cache_entry_t> cache;
+    size_t gc_threshold;
+
+    bool is_terminal(node_id n) const {
+        return nodes[n].level == terminal_level;
+    }
+    node_id make_terminal(double);
+    node_id make_node(std::uint32_t level, node_id low, node_id high);
+    node_id allocate(node_t const&);
+    size_t bucket_of(std::uint32_t level, node_id low, node_id high, double value) const;
+    void rehash(size_t size);
+    void maybe_collect();
+
+    cache_entry_t& cache_slot(std::uint8_t op, node_id f, node_id g, node_id h);
+    bool cached(std::uint8_t op, node_id f, node_id g, node_id h, node_id& result);
+    void remember(std::uint8_t op, node_id f, node_id g, node_id h, node_id result);
+
+    node_id apply_rec(op_t, node_id, node_id);
+    node_id apply_rec(op_t, node_id);
+    node_id ite_rec(node_id f, node_id g, node_id h);
+    node_id abstract_rec(op_t, node_id f, node_id cube);
+    node_id shift_rec(node_id f, std::int32_t delta);
+    std::pair<double, double> terminal_range(node_id) const;
+
+    mtbdd_t handle(node_id n) {
+        return mtbdd_t{this, n};
+    }
+};
+
+}
+
+#endif
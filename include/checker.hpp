@@ -0,0 +1,152 @@
+#ifndef PML_CHECKER_HPP
+#define PML_CHECKER_HPP
+
+#include <vector>
+
+#include "utility.hpp"
+#include "MDP.hpp"
+#include "mdp_explore.hpp"
+
+namespace pctl {
+struct pctl_t;
+}
+
+// in-process model checker for `mdp::mdp_t`, an alternative to PRISM
+namespace checker {
+
+enum class engine_t {
+    Prism, Native,
+    Symbolic // MTBDD interval iteration, for large but regular state spaces
+};
+
+enum class iteration_t {
+    Value,   // converges from below only, like PRISM's default
+    Interval // converging lower and upper bounds
+};
+
+// how a sweep updates the vector; Gauss-Seidel and SOR run on one thread
+enum class method_t {
+    Jacobi,      // from the previous vector
+    GaussSeidel, // in place
+    SOR          // in place, relaxed by `omega`
+};
+
+enum class exploration_t {
+    Full,    // the whole reachable state space before solving
+    OnTheFly // most probable states first until the bounds are tight enough
+};
+
+struct options_t {
+    engine_t engine = engine_t::Prism;
+    exploration_t exploration = exploration_t::Full;
+    bool bisimulation = true; // solve the bisimulation quotient of the explored model
+    iteration_t iteration = iteration_t::Interval;
+    method_t method = method_t::Jacobi;
+    double omega = 0.9; // PRISM's default
+    double precision = 1e-6; // convergence threshold of iterative methods
+    size_t max_iterations = 100000;
+    size_t exact_threshold = 1000; // models with at most this many states are solved exactly
+    unsigned threads = 0; // for iterative methods; 0 means one per hardware thread
+    int max_depth = 8; // stack of recursive functions whose depth is not derived
+};
+
+using mdp::rational_t;
+
+// the exact value of a finite double
+rational_t to_rational(double);
+
+enum class objective_t {
+    Min, Max
+};
+
+// states in an order where every successor comes later, ignoring the
+// self-loops of absorbing states; nullopt if the state graph is cyclic
+util::optional<std::vector<size_t>> topological_order(mdp::explicit_mdp_t const&);
+
+// graph-based fixpoints over the explicit model, named as in PRISM:
+// prob0A: Pmax=0, prob0E: Pmin=0, prob1E: Pmax=1, prob1A: Pmin=1
+std::vector<bool> prob0a(mdp::explicit_mdp_t const&, std::vector<bool> const& target);
+std::vector<bool> prob0e(mdp::explicit_mdp_t const&, std::vector<bool> const& target);
+std::vector<bool> prob1e(mdp::explicit_mdp_t const&, std::vector<bool> const& target);
+std::vector<bool> prob1a(mdp::explicit_mdp_t const&, std::vector<bool> const& target);
+
+// states whose probability is exactly 0 (`no`) or 1 (`yes`)
+struct qualitative_t {
+    std::vector<bool> no, yes;
+};
+qualitative_t precompute(mdp::explicit_mdp_t const&, std::vector<bool> const& target, objective_t);
+
+// strongly connected components of the graph over `states` that only
+// follows `choices`, sinks first (i.e. in reverse topological order)
+std::vector<std::vector<size_t>> strongly_connected_components(
+        mdp::explicit_mdp_t const&,
+        std::vector<bool> const& states,
+        std::vector<bool> const& choices);
+
+// maximal end components within `states`; `inside` marks the choices
+// that stay in the component of their state
+struct end_components_t {
+    std::vector<std::vector<size_t>> components;
+    std::vector<bool> inside;
+};
+end_components_t maximal_end_components(mdp::explicit_mdp_t const&, std::vector<bool> const& states);
+
+enum class verdict_t {
+    True, False,
+    Unknown // bounds still straddle a threshold at the requested precision
+};
+
+enum class comparison_t {
+    Lt, Leq, Eq, Geq, Gt
+};
+
+// `P op bound` for the probability P of the initial state
+struct threshold_t {
+    comparison_t op;
+    rational_t bound;
+
+    // the verdict that holds for every P in [lower, upper]
+    verdict_t decide(rational_t const& lower, rational_t const& upper) const;
+};
+
+// lower and upper bounds of Pmin/Pmax=? [F target] for every state
+struct bounds_t {
+    std::vector<double> lower, upper;
+};
+// probabilistic bisimulation quotient that keeps `target` apart; state
+// `block_of[s]` of the quotient has the same probabilities as `s`
+struct quotient_t {
+    mdp::explicit_mdp_t model;
+    std::vector<bool> target;
+    std::vector<size_t> block_of;
+};
+quotient_t bisimulation_quotient(mdp::explicit_mdp_t const&, std::vector<bool> const& target);
+
+// with a threshold, iteration stops as soon as the bounds of the initial
+// state decide it and the other states are left unconverged
+bounds_t reach_bounds(
+        mdp::explicit_mdp_t const&,
+        std::vector<bool> const& target,
+        objective_t, options_t const&,
+        util::optional<threshold_t> const& threshold = util::nullopt);
+
+// Pmin/Pmax=? [F target] for every state (lower bounds if iterated)
+std::vector<double> reach_probability(
+        mdp::explicit_mdp_t const&,
+        std::vector<bool> const& target,
+        objective_t, options_t const&);
+
+// exact Pmin/Pmax=? [F target] for every state by policy iteration,
+// solving each policy's linear system by Gaussian elimination over
+// rationals; probabilities are the model's `exact_probs`, or the exact
+// values of its doubles if it has none
+std::vector<rational_t> reach_exact(
+        mdp::explicit_mdp_t const&,
+        std::vector<bool> const& target,
+        objective_t);
+
+verdict_t check(mdp::mdp_t const&, pctl::pctl_t const&, options_t const&);
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 #ifndef PML_LOGIC_HPP
 #define PML_LOGIC_HPP
 
+#include <unordered_set>
 #include "utility.hpp"
 
 namespace logic {
@@ -222,13 +223,21 @@ ptr<term_t> subst(ptr<term_t> const& t, std::string const& var, ptr<formula_t> c
 ptr<formula_t> subst(ptr<formula_t> const& f, std::string const& var, ptr<term_t> const& t);
 ptr<formula_t> subst(ptr<formula_t> const& f1, std::string const& var, ptr<formula_t> const& f2);
 
+// the names of the variables that are read
+std::unordered_set<std::string> free_variables(formula_t const&);
+
 std::string to_debug_string(domain_kind_t);
 std::string to_debug_string(term_t const&);
 std::string to_debug_string(formula_t const&);
 std::string to_debug_string(predicate_t const&);
 
-std::string output(term_t const& term, int accept, bool pos);
-std::string output(formula_t const& formula, int accept, bool pos);
+// PRISM properties; `pos` selects Pmin or Pmax for `Prob`, which is a
+// plain P on deterministic models. Runs that end in `overflow` count as
+// reaching the target only when `pos` is false.
+std::string output(term_t const& term, int accept, bool pos, bool deterministic = false,
+        util::optional<int> overflow = util::nullopt);
+std::string output(formula_t const& formula, int accept, bool pos, bool deterministic = false,
+        util::optional<int> overflow = util::nullopt);
 
 inline static std::ostream& operator<<(std::ostream& os, term_t const& t) {
     os << to_debug_string(t);
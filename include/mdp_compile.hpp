@@ -0,0 +1,118 @@
+#ifndef PML_MDP_COMPILE_HPP
+#define PML_MDP_COMPILE_HPP
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+#include <boost/multiprecision/cpp_int.hpp>
+
+#include "utility.hpp"
+#include "MDP.hpp"
+
+namespace mdp {
+
+using rational_t = boost::multiprecision::cpp_rational;
+
+// values of `mdp_t::variables`, in declaration order (bool as 0/1)
+using state_t = std::vector<int>;
+
+enum class opcode_t : std::uint8_t {
+    Const, Load,
+    Not, Mul, Div, Add, Sub,
+    Lt, Leq, Geq, Gt, Eq, Neq,
+    And, Or, Iff, Impl,
+    Select, Min, Max, Floor, Ceil, Pow, Mod, Log
+};
+
+struct instr_t {
+    opcode_t op;
+    std::uint32_t arg; // slot of Load, arity of Min/Max
+    double value;      // operand of Const
+};
+
+// postfix bytecode over state slots; names are resolved at compile time
+struct compiled_expr_t {
+    std::vector<instr_t> code;
+    std::uint32_t stack_depth = 0;
+
+    bool is_constant() const {
+        return code.size() == 1 && code[0].op == opcode_t::Const;
+    }
+    double eval(state_t const&) const;
+private:
+    double run(double* stack, state_t const&) const;
+};
+
+struct assignment_t {
+    std::uint32_t slot;
+    compiled_expr_t value;
+    int min, max;
+};
+
+// `(x'=e)&(y'=f)&...` decoded into simultaneous assignments
+struct compiled_update_t {
+    std::vector<assignment_t> assignments;
+    void apply(state_t const& current, state_t& next) const;
+};
+
+struct compiled_branch_t {
+    compiled_expr_t prob;
+    compiled_update_t update;
+    std::uint32_t exact = 0; // index of the probability in `exact_probs`
+};
+
+struct compiled_command_t {
+    compiled_expr_t guard;
+    std::vector<compiled_branch_t> branches;
+};
+
+struct compiled_mdp_t {
+    std::vector<std::string> variables;
+    state_t initial;
+    std::vector<compiled_command_t> commands;
+    // commands indexed by location; `unlocated` ones are enabled anywhere
+    std::vector<std::vector<std::uint32_t>> by_location;
+    std::vector<std::uint32_t> unlocated;
+    util::optional<std::uint32_t> location_slot;
+    // the distinct branch probabilities as rationals, starting with 1; empty
+    // if some probability is not a rational constant
+    std::vector<rational_t> exact_probs;
+
+    std::vector<std::uint32_t> const& commands_at(state_t const& s) const {
+        static std::vector<std::uint32_t> const none;
+        if (!location_slot) // no `location`: every indexed command is a candidate
+            return all_located;
+        int loc = s[*location_slot];
+        if (loc < 0 || (size_t)loc >= by_location.size())
+            return none;
+        return by_location[loc];
+    }
+    // compile an expression over this model's variables and constants
+    compiled_expr_t compile(expr_t const&) const;
+
+    explicit compiled_mdp_t() = default;
+    explicit compiled_mdp_t(mdp_t const&);
+private:
+    std::vector<std::uint32_t> all_located;
+    std::unordered_map<std::string, std::uint32_t> slots;
+    std::unordered_map<std::string, int> constants;
+    std::unordered_map<std::string, ptr<expr_t>> formulas;
+    std::vector<bound_t> bounds;
+
+    compiled_update_t compile_update(expr_t const&) const;
+    void emit(expr_t const&, compiled_expr_t&, std::uint32_t depth) const;
+    util::optional<rational_t> exact_value(expr_t const&) const;
+};
+
+// slots in an order that keeps variables read or written by the same
+// commands adjacent, starting from `location`; the size of BDDs over the
+// state depends heavily on it
+std::vector<std::uint32_t> variable_order(compiled_mdp_t const&);
+// reorders the declarations of `mdp.variables` by `variable_order`
+void order_variables(mdp_t&);
+
+}
+
+#endif
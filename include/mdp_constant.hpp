@@ -1,3 +1,5 @@
+#include <string>
+#include <ostream>
 #include <boost/variant.hpp>
 
 namespace mdp {
@@ -0,0 +1,121 @@
+#ifndef PML_MDP_EXPLORE_HPP
+#define PML_MDP_EXPLORE_HPP
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <queue>
+#include <utility>
+
+#include "utility.hpp"
+#include "MDP.hpp"
+#include "mdp_compile.hpp"
+
+namespace mdp {
+
+struct state_hash_t {
+    size_t operator()(state_t const& s) const {
+        size_t h = s.size();
+        for (int v : s)
+            h ^= std::hash<int>{}(v) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+
+struct transition_t {
+    double prob;
+    state_t next;
+    std::uint32_t exact = 0; // index of `prob` in `exact_probs()`
+};
+using choice_t = std::vector<transition_t>;
+
+// enumerates the successors of a state, looking only at the commands
+// indexed under the state's location
+struct successor_generator_t {
+    explicit successor_generator_t(mdp_t const& mdp) :
+        model{mdp}
+    {}
+
+    state_t const& initial_state() const {
+        return model.initial;
+    }
+    // one choice per enabled command; a deadlock gets a self-loop like PRISM
+    void successors(state_t const&, std::vector<choice_t>&) const;
+
+    compiled_expr_t compile(expr_t const& e) const {
+        return model.compile(e);
+    }
+    std::vector<std::string> const& variables() const {
+        return model.variables;
+    }
+    std::vector<rational_t> const& exact_probs() const {
+        return model.exact_probs;
+    }
+private:
+    compiled_mdp_t model;
+};
+
+// reachable state space in CSR form:
+// choices of state s are [choice_begin[s], choice_begin[s+1]),
+// transitions of choice c are [transition_begin[c], transition_begin[c+1]).
+struct explicit_mdp_t {
+    std::vector<std::string> variables;
+    std::vector<state_t> states; // states[0] is the initial state
+    std::vector<size_t> choice_begin;
+    std::vector<size_t> transition_begin;
+    std::vector<size_t> successors;
+    std::vector<double> probs;
+    // transition t has probability exactly `exact_probs[exact_of[t]]`;
+    // `exact_of` is empty if the probabilities are known as doubles only
+    std::vector<rational_t> exact_probs;
+    std::vector<std::uint32_t> exact_of;
+
+    bool is_exact() const { return !exact_of.empty(); }
+    size_t state_count() const { return states.size(); }
+    size_t choice_count() const { return transition_begin.size() - 1; }
+    size_t transition_count() const { return successors.size(); }
+};
+
+explicit_mdp_t explore(successor_generator_t const&);
+explicit_mdp_t explore(mdp_t const&);
+
+// explores the most probable unexpanded state first, where a state's
+// priority is the largest probability of a path to it found so far.
+// States satisfying `stop` are never expanded.
+struct partial_explorer_t {
+    partial_explorer_t(successor_generator_t const& generator, compiled_expr_t stop);
+
+    // expands up to `count` more states
+    void expand(size_t count);
+    bool complete() const {
+        return queue.empty();
+    }
+    // the explored part, where every unexpanded state gets a self-loop;
+    // `frontier` marks the unexpanded states not satisfying `stop`
+    explicit_mdp_t snapshot(std::vector<bool>& frontier) const;
+    std::vector<bool> const& stopped() const {
+        return is_stopped;
+    }
+
+private:
+    size_t id_of(state_t const& s, double priority);
+
+    successor_generator_t const& generator;
+    compiled_expr_t stop;
+    std::vector<state_t> states;
+    std::unordered_map<state_t, size_t, state_hash_t> ids;
+    std::vector<bool> is_stopped, expanded;
+    std::vector<double> priority;
+    struct edge_t {
+        double prob;
+        std::uint32_t exact;
+        size_t next;
+    };
+    // (choice, edge) of expanded states
+    std::vector<std::vector<std::vector<edge_t>>> choices;
+    std::priority_queue<std::pair<double, size_t>> queue;
+};
+
+}
+
+#endif
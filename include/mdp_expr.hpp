@@ -1,6 +1,10 @@
 #ifndef PML_MDP_EXPR_HPP
 #define PML_MDP_EXPR_HPP
 
+#include <string>
+#include <vector>
+#include "utility.hpp"
+
 namespace mdp {
 
 enum class expr_kind_t {
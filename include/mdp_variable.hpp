@@ -33,11 +33,6 @@ struct variable_t {
         name{name}, data{bool_var_t{b}}
     {}
 
-    variable_t& operator=(variable_t const& rhs) {
-        name = rhs.name;
-        data = rhs.data;
-        return *this;
-    }
     bool is_int() const { return data.which() == 0; }
     bool is_bool() const { return data.which() == 1; }
     int_var_t const& as_int() const {
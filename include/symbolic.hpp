@@ -0,0 +1,84 @@
+#ifndef PML_SYMBOLIC_HPP
+#define PML_SYMBOLIC_HPP
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+#include "bdd.hpp"
+#include "MDP.hpp"
+#include "mdp_compile.hpp"
+#include "checker.hpp"
+
+namespace checker {
+
+// `mdp_t` encoded with MTBDDs. Every variable is binary encoded, offset
+// by its minimum; bit k of the current state is at level 2k and bit k of
+// the next state at level 2k+1.
+struct symbolic_mdp_t {
+    explicit symbolic_mdp_t(mdp::mdp_t const&);
+
+    // an expression over the current state
+    bdd::mtbdd_t encode(mdp::expr_t const&);
+    // number of states reachable from the initial state
+    double reachable_states();
+    // bounds of Pmin/Pmax=? [F target] in the initial state by interval
+    // iteration
+    std::pair<double, double> reach(
+            bdd::mtbdd_t const& target,
+            objective_t, options_t const&,
+            util::optional<threshold_t> const& threshold = util::nullopt);
+
+    bdd::manager_t manager;
+
+private:
+    struct encoded_var_t {
+        int min, max;
+        std::uint32_t first_bit, bits;
+    };
+    // an integer in two's complement as 0/1 MTBDDs, least significant bit
+    // first, and the range of the values it takes
+    struct bits_t {
+        std::vector<bdd::mtbdd_t> bits;
+        long long min, max;
+    };
+    struct encoded_command_t {
+        bdd::mtbdd_t guard;       // 0/1 over the current state
+        bdd::mtbdd_t transitions; // probability of (current, next)
+    };
+
+    mdp::compiled_mdp_t compiled;
+    std::vector<encoded_var_t> vars;
+    std::uint32_t bit_count = 0;
+    std::vector<encoded_command_t> commands;
+    bdd::mtbdd_t zero, one;
+    bdd::mtbdd_t valid, initial, enabled, relation;
+    bdd::mtbdd_t current_cube, next_cube;
+    util::optional<bdd::mtbdd_t> reachable;
+    std::vector<bool> initial_assignment;
+
+    bdd::mtbdd_t value_of(size_t slot, bool next);
+    bdd::mtbdd_t encode(mdp::compiled_expr_t const&);
+    bdd::mtbdd_t encode(mdp::compiled_update_t const&);
+    bdd::mtbdd_t assignment(size_t slot, mdp::compiled_expr_t const& value);
+
+    // integer expressions bit by bit, where the MTBDD of a value would
+    // need a terminal for each value; nullopt for other expressions
+    util::optional<bits_t> encode_bits(mdp::compiled_expr_t const&);
+    static bdd::mtbdd_t const& bit(bits_t const&, std::size_t i);
+    bits_t bits_of(size_t slot);
+    bits_t constant_bits(long long);
+    bits_t boolean(bdd::mtbdd_t const&);
+    bits_t add(bits_t const&, bits_t const&, bool subtract);
+    bits_t mul(bits_t const&, bits_t const&);
+    bits_t select(bdd::mtbdd_t const& cond, bits_t const&, bits_t const&);
+    bdd::mtbdd_t less(bits_t const&, bits_t const&);
+    bdd::mtbdd_t equal(bits_t const&, bits_t const&);
+    bdd::mtbdd_t truth(bits_t const&);
+    bdd::mtbdd_t const& reachable_set();
+    bdd::mtbdd_t prob0(bdd::mtbdd_t const& target, objective_t);
+};
+
+}
+
+#endif
@@ -1,6 +1,9 @@
 #ifndef PML_TRANS_TO_MDP_HPP
 #define PML_TRANS_TO_MDP_HPP
 
+#include <vector>
+#include <unordered_set>
+
 #include "utility.hpp"
 #include "MDP.hpp"
 
@@ -14,37 +17,77 @@ struct refinement_type_t;
 struct dependent_type_t;
 }
 
-struct translation_data {
-    static int fresh_location() {
+struct function_info_t;
+
+// fresh locations and variable names of one translation; every
+// translation owns its context, so translations can run concurrently
+struct translation_context_t {
+    // `letfun`s in scope, innermost last
+    std::vector<function_info_t*> functions;
+    // frames of the stack of a recursive function whose depth can not be
+    // derived from the bounds of its arguments
+    int max_depth = 8;
+    // the location every stack overflow ends in, once a function has one
+    util::optional<int> overflow;
+    // recursive functions whose stack has `max_depth` frames
+    std::vector<std::string> undecided_depth;
+
+    int fresh_location() {
         return location_count++;
     }
-    static int current_location() {
+    int current_location() const {
         return location_count;
     }
-    static std::string fresh_var() {
-        return "v" + std::to_string(var_count++);
+    // program identifiers start with a letter, so names starting with
+    // `_` can not be shadowed by a `let` or a parameter
+    std::string fresh_var() {
+        return "_v" + std::to_string(var_count++);
     }
-    static void init() {
-        location_count = 0;
-        var_count = 0;
+    std::string fresh_formula() {
+        return "_f" + std::to_string(formula_count++);
     }
 private:
-    static int location_count;
-    static int var_count;
+    int location_count = 0;
+    int var_count = 0;
+    int formula_count = 0;
 };
 
 struct value_info_t {
     std::string name;
     util::optional<bound_t> bound;
+    // a literal is its own value and has no name
+    ptr<mdp::expr_t> literal = nullptr;
+
+    ptr<mdp::expr_t> expr() const {
+        return literal ? literal : make<mdp::var_expr_t>(name);
+    }
 };
 
 struct mdp_with_info_t {
     mdp::mdp_t mdp;
     int init, accept;
     value_info_t value;
+    // where a call that overflows the stack of a recursive function ends;
+    // such a run may have ended with any value
+    util::optional<int> overflow = util::nullopt;
+    std::vector<std::string> undecided_depth = {};
 };
 
-mdp_with_info_t translate_to_mdp(ast::expr_t const&);
+mdp_with_info_t translate_to_mdp(ast::expr_t const&, int max_depth = 8);
+// merges every location that is left with probability 1 by its only
+// command into the command that leads there, then renumbers locations
+void fuse_deterministic_chains(mdp_with_info_t&);
+// replaces each constant outcome of a branching command by the least
+// outcome that satisfies the same comparisons, for variables that are
+// only read through comparisons with constants, and merges the branches
+// that become equal; the variables that the property reads (`observed`)
+// keep every outcome
+void abstract_rand_branches(mdp_with_info_t&, std::unordered_set<std::string> const& observed = {});
+// resets variables to their initial value once they can no longer be
+// read, drops variables that are never read, and lets variables whose
+// lifetimes do not overlap share one declaration; the variables that the
+// property reads (`observed`) are live at the end and keep their own
+void reuse_dead_variables(mdp_with_info_t&, std::unordered_set<std::string> const& observed = {});
 pctl::pctl_t translate_to_pctl(ast::refinement_type_t const&, mdp_with_info_t const&);
 
 #endif
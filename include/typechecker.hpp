@@ -3,10 +3,11 @@
 
 #include "result.hpp"
 #include "translate.hpp"
+#include "checker.hpp"
 
 namespace typechecker {
 
-bool typecheck(ast::expr_t const&);
+bool typecheck(ast::expr_t const&, checker::options_t const& = checker::options_t{});
 
 }
 
@@ -5,35 +5,55 @@
 
 namespace mdp {
 
+template<typename Decl>
+static Decl* find_decl(name_index_t& index, std::vector<Decl>& decls, std::string const& name) {
+    if (index.indexed > decls.size()) {
+        index.position.clear();
+        index.indexed = 0;
+    }
+    for (; index.indexed < decls.size(); ++index.indexed)
+        index.position.emplace(decls[index.indexed].name, index.indexed);
+    auto found = index.position.find(name);
+    if (found == index.position.end())
+        return nullptr;
+    if (found->second >= decls.size() || decls[found->second].name != name) {
+        index.indexed = decls.size() + 1; // rebuild
+        return find_decl(index, decls, name);
+    }
+    return &decls[found->second];
+}
+
 mdp_t mdp_t::merge(mdp_t&& lhs, mdp_t&& rhs) {
+    auto size = [](mdp_t const& m) {
+        return m.variables.size() + m.constants.size() + m.commands.size();
+    };
+    if (size(lhs) < size(rhs))
+        std::swap(lhs, rhs);
     mdp_t result{std::move(lhs)};
 
-    result.variables.reserve(result.variables.size() + rhs.variables.size());
     for (auto&& var : rhs.variables) {
-        if (var.is_int() && var.name == "location")
-            continue;
-        auto found = std::find_if(
-                result.variables.begin(), result.variables.end(),
-                [&](mdp::variable_t const& var_) {
-                    return var_.name == var.name;
-                });
-        if (found != result.variables.end())
+        auto found = find_decl(result.variable_index, result.variables, var.name);
+        if (!found) {
+            result.variables.emplace_back(std::move(var));
             continue;
-        result.variables.emplace_back(std::move(var));
+        }
+        // e.g. `location` or a name bound in both branches of an `if`
+        if (found->is_int() && var.is_int()) {
+            auto& bound = boost::get<int_var_t>(found->data).bound;
+            bound = bound | var.as_int().bound;
+        }
     }
 
-    result.constants.reserve(result.constants.size() + rhs.constants.size());
     for (auto&& cnst : rhs.constants) {
-        auto found = std::find_if(
-                result.constants.begin(), result.constants.end(),
-                [&](mdp::constant_t const& cnst_) {
-                    return cnst_.name == cnst.name;
-                });
-        if (found != result.constants.end())
-            continue;
-        result.constants.emplace_back(std::move(cnst));
+        if (!find_decl(result.constant_index, result.constants, cnst.name))
+            result.constants.emplace_back(std::move(cnst));
     }
 
+    // fresh names of one translation never clash
+    std::move(
+            rhs.formulas.begin(), rhs.formulas.end(),
+            std::back_inserter(result.formulas));
+
     result.commands.reserve(result.commands.size() + rhs.commands.size());
     std::move(
             rhs.commands.begin(), rhs.commands.end(),
@@ -41,6 +61,102 @@ mdp_t mdp_t::merge(mdp_t&& lhs, mdp_t&& rhs) {
     return result;
 }
 
+util::optional<int> guard_location(expr_t const& guard) {
+    if (guard.kind() != expr_kind_t::BinOp)
+        return util::nullopt;
+    auto const& binop = cast<binop_expr_t>(guard);
+    switch (binop.binop_kind) {
+    case binop_kind_t::Eq:
+        if (binop.lhs->kind() == expr_kind_t::Var &&
+                cast<var_expr_t>(*binop.lhs).name == "location" &&
+                binop.rhs->kind() == expr_kind_t::Int)
+            return cast<int_expr_t>(*binop.rhs).n;
+        return util::nullopt;
+    case binop_kind_t::And: {
+        auto loc = guard_location(*binop.lhs);
+        if (loc)
+            return loc;
+        return guard_location(*binop.rhs);
+        }
+    default:
+        return util::nullopt;
+    }
+}
+
+static void conjuncts(expr_t const& e, std::vector<expr_t const*>& result) {
+    if (e.kind() == expr_kind_t::BinOp && cast<binop_expr_t>(e).binop_kind == binop_kind_t::And) {
+        conjuncts(*cast<binop_expr_t>(e).lhs, result);
+        conjuncts(*cast<binop_expr_t>(e).rhs, result);
+    } else
+        result.push_back(&e);
+}
+
+// `var=k`
+static bool is_var_eq_int(expr_t const& e) {
+    if (e.kind() != expr_kind_t::BinOp)
+        return false;
+    auto const& binop = cast<binop_expr_t>(e);
+    return binop.binop_kind == binop_kind_t::Eq &&
+        binop.lhs->kind() == expr_kind_t::Var &&
+        binop.rhs->kind() == expr_kind_t::Int;
+}
+
+static bool contradict(expr_t const& lhs, expr_t const& rhs) {
+    if (lhs.kind() == expr_kind_t::Neg && *cast<neg_expr_t>(lhs).inner == rhs)
+        return true;
+    if (rhs.kind() == expr_kind_t::Neg && *cast<neg_expr_t>(rhs).inner == lhs)
+        return true;
+    if (!is_var_eq_int(lhs) || !is_var_eq_int(rhs))
+        return false;
+    auto const& l = cast<binop_expr_t>(lhs);
+    auto const& r = cast<binop_expr_t>(rhs);
+    return
+        cast<var_expr_t>(*l.lhs).name == cast<var_expr_t>(*r.lhs).name &&
+        cast<int_expr_t>(*l.rhs).n != cast<int_expr_t>(*r.rhs).n;
+}
+
+bool is_deterministic(mdp_t const& mdp) {
+    auto index = mdp.index_commands();
+    auto enabled = [&](size_t i) {
+        return !mdp.commands[i].branches.empty();
+    };
+    if (std::any_of(index.unlocated.begin(), index.unlocated.end(), enabled))
+        return false;
+    for (auto const& at : index.by_location) {
+        std::vector<std::vector<expr_t const*>> guards;
+        for (auto i : at.second) {
+            if (!enabled(i))
+                continue;
+            guards.emplace_back();
+            conjuncts(*mdp.commands[i].guard, guards.back());
+        }
+        for (size_t i=0; i<guards.size(); ++i) {
+            for (size_t j=i+1; j<guards.size(); ++j) {
+                bool exclusive = false;
+                for (auto lhs : guards[i]) {
+                    for (auto rhs : guards[j])
+                        exclusive = exclusive || contradict(*lhs, *rhs);
+                }
+                if (!exclusive)
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+command_index_t mdp_t::index_commands() const {
+    command_index_t index;
+    for (size_t i=0; i<commands.size(); ++i) {
+        auto loc = guard_location(*commands[i].guard);
+        if (loc)
+            index.by_location[*loc].push_back(i);
+        else
+            index.unlocated.push_back(i);
+    }
+    return index;
+}
+
 std::ostream& operator<<(std::ostream& os, command_t const& command) {
     if (command.branches.empty())
         return os;
@@ -53,7 +169,11 @@ std::ostream& operator<<(std::ostream& os, command_t const& command) {
 }
 
 std::ostream& operator<<(std::ostream& os, mdp_t const& mdp) {
-    os << "mdp" << std::endl << std::endl;
+    os << (is_deterministic(mdp) ? "dtmc" : "mdp") << std::endl << std::endl;
+    for (auto const& formula : mdp.formulas)
+        os << "formula " << formula.name << " = " << *formula.value << ";" << std::endl;
+    if (!mdp.formulas.empty())
+        os << std::endl;
     os << "module " << mdp.module_name << std::endl << std::endl;
 
     for (auto const& var : mdp.variables)
@@ -99,6 +219,14 @@ bool operator==(mdp_t const& lhs, mdp_t const& rhs) {
         if (lhs.commands[i] != rhs.commands[i])
             return false;
     }
+
+    if (lhs.formulas.size() != rhs.formulas.size())
+        return false;
+
+    for (size_t i=0; i<lhs.formulas.size(); ++i) {
+        if (lhs.formulas[i].name != rhs.formulas[i].name || *lhs.formulas[i].value != *rhs.formulas[i].value)
+            return false;
+    }
     return true;
 }
 
@@ -3,7 +3,7 @@
 namespace pctl {
 
 void pctl_t::output(std::ostream& os) const {
-    os << logic::output(*constraint, final_location, true) << std::endl;
+    os << logic::output(*constraint, final_location, true, deterministic, overflow_location) << std::endl;
 }
 
 }
@@ -0,0 +1,470 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "bdd.hpp"
+
+namespace bdd {
+
+mtbdd_t::mtbdd_t(manager_t* manager, node_id id) :
+    manager{manager}, node{id}
+{
+    if (manager)
+        ++manager->nodes[node].refs;
+}
+
+mtbdd_t::mtbdd_t(mtbdd_t const& other) :
+    mtbdd_t{other.manager, other.node}
+{}
+
+mtbdd_t::mtbdd_t(mtbdd_t&& other) noexcept :
+    manager{other.manager}, node{other.node}
+{
+    other.manager = nullptr;
+}
+
+mtbdd_t& mtbdd_t::operator=(mtbdd_t const& other) {
+    mtbdd_t copy{other};
+    std::swap(manager, copy.manager);
+    std::swap(node, copy.node);
+    return *this;
+}
+
+mtbdd_t& mtbdd_t::operator=(mtbdd_t&& other) noexcept {
+    std::swap(manager, other.manager);
+    std::swap(node, other.node);
+    return *this;
+}
+
+mtbdd_t::~mtbdd_t() {
+    if (manager)
+        --manager->nodes[node].refs;
+}
+
+// levels of freed nodes, never looked up in the unique table
+static constexpr std::uint32_t free_level = UINT32_MAX - 1;
+
+// computed table tags besides `op_t`
+static constexpr std::uint8_t abstract_tag = 64;
+static constexpr std::uint8_t shift_tag = 128;
+static constexpr std::uint8_t ite_tag = 129;
+
+static size_t mix(size_t h, size_t v) {
+    return h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+}
+
+static double eval_op(op_t op, double a, double b) {
+    switch (op) {
+    case op_t::Add: return a + b;
+    case op_t::Sub: return a - b;
+    case op_t::Mul: return a * b;
+    case op_t::Div: return a / b;
+    case op_t::Min: return std::min(a, b);
+    case op_t::Max: return std::max(a, b);
+    case op_t::Pow: return std::pow(a, b);
+    case op_t::Mod: return std::fmod(a, b);
+    case op_t::Log: return std::log(a) / std::log(b);
+    case op_t::Lt: return a < b;
+    case op_t::Leq: return a <= b;
+    case op_t::Geq: return a >= b;
+    case op_t::Gt: return a > b;
+    case op_t::Eq: return a == b;
+    case op_t::Neq: return a != b;
+    case op_t::And: return a != 0 && b != 0;
+    case op_t::Or: return a != 0 || b != 0;
+    case op_t::Iff: return (a != 0) == (b != 0);
+    case op_t::Impl: return a == 0 || b != 0;
+    default:
+        throw std::logic_error{"not a binary operator"};
+    }
+}
+
+// whether `r = a op b` was rounded; the errors of sums and products are
+// recovered exactly (TwoSum, fma) unless they underflow
+static bool is_rounded(op_t op, double a, double b, double r) {
+    switch (op) {
+    case op_t::Add: case op_t::Sub: {
+        double b_ = op == op_t::Add ? b : -b;
+        double z = r - a;
+        return (a - (r - z)) + (b_ - z) != 0;
+        }
+    case op_t::Mul:
+        if (a == 0 || b == 0)
+            return false;
+        return std::abs(r) < std::numeric_limits<double>::min() || std::fma(a, b, -r) != 0;
+    case op_t::Div:
+        if (a == 0)
+            return false;
+        return std::abs(r) < std::numeric_limits<double>::min() || std::fma(r, b, -a) != 0;
+    case op_t::Pow: case op_t::Log:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static double eval_op(op_t op, double a) {
+    switch (op) {
+    case op_t::Not: return a == 0;
+    case op_t::Floor: return std::floor(a);
+    case op_t::Ceil: return std::ceil(a);
+    default:
+        throw std::logic_error{"not a unary operator"};
+    }
+}
+
+manager_t::manager_t(size_t cache_size) :
+    cache(cache_size, cache_entry_t{0, 0, 0, 0, 0, false}),
+    gc_threshold{1 << 16}
+{
+    if (cache_size == 0 || (cache_size & (cache_size - 1)) != 0)
+        throw std::invalid_argument{"cache size must be a power of two"};
+    rehash(1 << 16);
+}
+
+size_t manager_t::bucket_of(std::uint32_t level, node_id low, node_id high, double value) const {
+    size_t h = level;
+    if (level == terminal_level) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        h = mix(h, bits);
+    } else {
+        h = mix(mix(h, low), high);
+    }
+    return h & (buckets.size() - 1);
+}
+
+void manager_t::rehash(size_t size) {
+    buckets.assign(size, nil);
+    for (node_id n=0; n<nodes.size(); ++n) {
+        auto& node = nodes[n];
+        if (node.level == free_level)
+            continue;
+        auto b = bucket_of(node.level, node.low, node.high, node.value);
+        node.next = buckets[b];
+        buckets[b] = n;
+    }
+}
+
+node_id manager_t::allocate(node_t const& node) {
+    if (live_nodes() >= buckets.size())
+        rehash(buckets.size() * 2);
+    node_id n;
+    if (!free.empty()) {
+        n = free.back();
+        free.pop_back();
+        nodes[n] = node;
+    } else {
+        n = static_cast<node_id>(nodes.size());
+        nodes.push_back(node);
+    }
+    auto b = bucket_of(node.level, node.low, node.high, node.value);
+    nodes[n].next = buckets[b];
+    buckets[b] = n;
+    return n;
+}
+
+node_id manager_t::make_terminal(double value) {
+    if (value == 0)
+        value = 0.0; // -0.0
+    auto b = bucket_of(terminal_level, 0, 0, value);
+    for (auto n = buckets[b]; n != nil; n = nodes[n].next) {
+        if (nodes[n].level == terminal_level && std::memcmp(&nodes[n].value, &value, sizeof(value)) == 0)
+            return n;
+    }
+    return allocate(node_t{terminal_level, 0, 0, value, nil, 0, false});
+}
+
+node_id manager_t::make_node(std::uint32_t level, node_id low, node_id high) {
+    if (low == high)
+        return low;
+    auto b = bucket_of(level, low, high, 0.0);
+    for (auto n = buckets[b]; n != nil; n = nodes[n].next) {
+        if (nodes[n].level == level && nodes[n].low == low && nodes[n].high == high)
+            return n;
+    }
+    return allocate(node_t{level, low, high, 0.0, nil, 0, false});
+}
+
+// operations only collect on entry, so intermediate results of a running
+// operation are never reclaimed
+void manager_t::maybe_collect() {
+    if (live_nodes() < gc_threshold)
+        return;
+    collect_garbage();
+    if (live_nodes() > gc_threshold / 2)
+        gc_threshold *= 2;
+}
+
+void manager_t::collect_garbage() {
+    std::vector<node_id> stack;
+    for (node_id n=0; n<nodes.size(); ++n) {
+        nodes[n].marked = false;
+        if (nodes[n].level != free_level && nodes[n].refs > 0)
+            stack.push_back(n);
+    }
+    while (!stack.empty()) {
+        auto n = stack.back();
+        stack.pop_back();
+        if (nodes[n].marked)
+            continue;
+        nodes[n].marked = true;
+        if (!is_terminal(n)) {
+            stack.push_back(nodes[n].low);
+            stack.push_back(nodes[n].high);
+        }
+    }
+    for (node_id n=0; n<nodes.size(); ++n) {
+        if (nodes[n].level != free_level && !nodes[n].marked) {
+            nodes[n].level = free_level;
+            free.push_back(n);
+        }
+    }
+    rehash(buckets.size());
+    for (auto& entry : cache)
+        entry.valid = false;
+}
+
+manager_t::cache_entry_t& manager_t::cache_slot(std::uint8_t op, node_id f, node_id g, node_id h) {
+    size_t key = mix(mix(mix(op, f), g), h);
+    return cache[key & (cache.size() - 1)];
+}
+
+bool manager_t::cached(std::uint8_t op, node_id f, node_id g, node_id h, node_id& result) {
+    auto const& entry = cache_slot(op, f, g, h);
+    if (!entry.valid || entry.op != op || entry.f != f || entry.g != g || entry.h != h)
+        return false;
+    result = entry.result;
+    return true;
+}
+
+void manager_t::remember(std::uint8_t op, node_id f, node_id g, node_id h, node_id result) {
+    cache_slot(op, f, g, h) = cache_entry_t{op, f, g, h, result, true};
+}
+
+mtbdd_t manager_t::constant(double value) {
+    maybe_collect();
+    return handle(make_terminal(value));
+}
+
+mtbdd_t manager_t::variable(std::uint32_t level) {
+    maybe_collect();
+    auto zero = make_terminal(0.0);
+    auto one = make_terminal(1.0);
+    return handle(make_node(level, zero, one));
+}
+
+node_id manager_t::apply_rec(op_t op, node_id f, node_id g) {
+    if (is_terminal(f) && is_terminal(g)) {
+        double a = nodes[f].value, b = nodes[g].value;
+        double r = eval_op(op, a, b);
+        if (!inexact && std::isfinite(a) && std::isfinite(b))
+            inexact = is_rounded(op, a, b, r);
+        return make_terminal(r);
+    }
+    auto is_value = [this](node_id n, double v) {
+        return is_terminal(n) && nodes[n].value == v;
+    };
+    switch (op) {
+    case op_t::Add:
+        if (is_value(f, 0.0)) return g;
+        if (is_value(g, 0.0)) return f;
+        break;
+    case op_t::Mul:
+        if (is_value(f, 0.0) || is_value(g, 1.0)) return f;
+        if (is_value(g, 0.0) || is_value(f, 1.0)) return g;
+        break;
+    case op_t::Min:
+    case op_t::Max:
+        if (f == g) return f;
+        break;
+    default:
+        break;
+    }
+
+    node_id result;
+    auto tag = static_cast<std::uint8_t>(op);
+    if (cached(tag, f, g, 0, result))
+        return result;
+    auto f_level = nodes[f].level, g_level = nodes[g].level;
+    auto level = std::min(f_level, g_level);
+    auto f_low = f_level == level ? nodes[f].low : f;
+    auto f_high = f_level == level ? nodes[f].high : f;
+    auto g_low = g_level == level ? nodes[g].low : g;
+    auto g_high = g_level == level ? nodes[g].high : g;
+    auto low = apply_rec(op, f_low, g_low);
+    auto high = apply_rec(op, f_high, g_high);
+    result = make_node(level, low, high);
+    remember(tag, f, g, 0, result);
+    return result;
+}
+
+node_id manager_t::apply_rec(op_t op, node_id f) {
+    if (is_terminal(f))
+        return make_terminal(eval_op(op, nodes[f].value));
+    node_id result;
+    auto tag = static_cast<std::uint8_t>(op);
+    if (cached(tag, f, nil, 0, result))
+        return result;
+    auto level = nodes[f].level;
+    auto f_high = nodes[f].high;
+    auto low = apply_rec(op, nodes[f].low);
+    auto high = apply_rec(op, f_high);
+    result = make_node(level, low, high);
+    remember(tag, f, nil, 0, result);
+    return result;
+}
+
+mtbdd_t manager_t::apply(op_t op, mtbdd_t const& f, mtbdd_t const& g) {
+    maybe_collect();
+    return handle(apply_rec(op, f.id(), g.id()));
+}
+
+mtbdd_t manager_t::apply(op_t op, mtbdd_t const& f) {
+    maybe_collect();
+    return handle(apply_rec(op, f.id()));
+}
+
+// not f*g + !f*h, which is NaN where the branch not taken is infinite
+node_id manager_t::ite_rec(node_id f, node_id g, node_id h) {
+    if (is_terminal(f))
+        return nodes[f].value != 0 ? g : h;
+    if (g == h)
+        return g;
+    node_id result;
+    if (cached(ite_tag, f, g, h, result))
+        return result;
+    auto level = std::min({nodes[f].level, nodes[g].level, nodes[h].level});
+    auto cofactor = [&](node_id n, bool high) {
+        if (nodes[n].level != level)
+            return n;
+        return high ? nodes[n].high : nodes[n].low;
+    };
+    auto low = ite_rec(cofactor(f, false), cofactor(g, false), cofactor(h, false));
+    auto high = ite_rec(cofactor(f, true), cofactor(g, true), cofactor(h, true));
+    result = make_node(level, low, high);
+    remember(ite_tag, f, g, h, result);
+    return result;
+}
+
+mtbdd_t manager_t::ite(mtbdd_t const& f, mtbdd_t const& g, mtbdd_t const& h) {
+    maybe_collect();
+    return handle(ite_rec(f.id(), g.id(), h.id()));
+}
+
+node_id manager_t::abstract_rec(op_t op, node_id f, node_id cube) {
+    if (is_terminal(cube))
+        return f;
+    node_id result;
+    auto tag = static_cast<std::uint8_t>(abstract_tag + static_cast<std::uint8_t>(op));
+    if (cached(tag, f, cube, 0, result))
+        return result;
+    auto f_level = nodes[f].level, cube_level = nodes[cube].level;
+    auto rest = nodes[cube].high;
+    if (cube_level < f_level) {
+        // `f` does not depend on this variable
+        result = abstract_rec(op, f, rest);
+        if (op == op_t::Add)
+            result = apply_rec(op_t::Add, result, result);
+    } else if (f_level < cube_level) {
+        auto f_high = nodes[f].high;
+        auto low = abstract_rec(op, nodes[f].low, cube);
+        auto high = abstract_rec(op, f_high, cube);
+        result = make_node(f_level, low, high);
+    } else {
+        auto f_high = nodes[f].high;
+        auto low = abstract_rec(op, nodes[f].low, rest);
+        auto high = abstract_rec(op, f_high, rest);
+        result = apply_rec(op, low, high);
+    }
+    remember(tag, f, cube, 0, result);
+    return result;
+}
+
+mtbdd_t manager_t::abstract(op_t op, mtbdd_t const& f, mtbdd_t const& cube) {
+    if (op != op_t::Add && op != op_t::Min && op != op_t::Max)
+        throw std::invalid_argument{"variables can only be abstracted by Add, Min or Max"};
+    maybe_collect();
+    return handle(abstract_rec(op, f.id(), cube.id()));
+}
+
+mtbdd_t manager_t::cube(std::vector<std::uint32_t> levels) {
+    maybe_collect();
+    std::sort(levels.begin(), levels.end());
+    auto zero = make_terminal(0.0);
+    auto result = make_terminal(1.0);
+    for (auto it = levels.rbegin(); it != levels.rend(); ++it)
+        result = make_node(*it, zero, result);
+    return handle(result);
+}
+
+node_id manager_t::shift_rec(node_id f, std::int32_t delta) {
+    if (is_terminal(f))
+        return f;
+    node_id result;
+    auto d = static_cast<node_id>(delta);
+    if (cached(shift_tag, f, d, 0, result))
+        return result;
+    auto level = nodes[f].level;
+    auto f_high = nodes[f].high;
+    auto low = shift_rec(nodes[f].low, delta);
+    auto high = shift_rec(f_high, delta);
+    result = make_node(static_cast<std::uint32_t>(level + delta), low, high);
+    remember(shift_tag, f, d, 0, result);
+    return result;
+}
+
+mtbdd_t manager_t::shift(mtbdd_t const& f, std::int32_t delta) {
+    maybe_collect();
+    return handle(shift_rec(f.id(), delta));
+}
+
+double manager_t::value(mtbdd_t const& terminal) const {
+    if (!is_terminal(terminal.id()))
+        throw std::logic_error{"not a terminal"};
+    return nodes[terminal.id()].value;
+}
+
+bool manager_t::is_constant(mtbdd_t const& f) const {
+    return is_terminal(f.id());
+}
+
+std::pair<double, double> manager_t::terminal_range(node_id f) const {
+    std::vector<bool> visited(nodes.size(), false);
+    std::vector<node_id> stack{f};
+    std::pair<double, double> result{INFINITY, -INFINITY};
+    while (!stack.empty()) {
+        auto n = stack.back();
+        stack.pop_back();
+        if (visited[n])
+            continue;
+        visited[n] = true;
+        if (is_terminal(n)) {
+            result.first = std::min(result.first, nodes[n].value);
+            result.second = std::max(result.second, nodes[n].value);
+        } else {
+            stack.push_back(nodes[n].low);
+            stack.push_back(nodes[n].high);
+        }
+    }
+    return result;
+}
+
+double manager_t::min_value(mtbdd_t const& f) const {
+    return terminal_range(f.id()).first;
+}
+
+double manager_t::max_value(mtbdd_t const& f) const {
+    return terminal_range(f.id()).second;
+}
+
+double manager_t::eval(mtbdd_t const& f, std::vector<bool> const& assignment) const {
+    auto n = f.id();
+    while (!is_terminal(n))
+        n = assignment[nodes[n].level] ? nodes[n].high : nodes[n].low;
+    return nodes[n].value;
+}
+
+}
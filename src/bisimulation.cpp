@@ -0,0 +1,183 @@
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <algorithm>
+
+#include "checker.hpp"
+
+namespace checker {
+
+using mdp::explicit_mdp_t;
+
+// inexact probabilities summed in different orders may differ in the last bits
+static long long quantize(double p) {
+    return std::llround(p * 1e12);
+}
+
+// exact probabilities by id, starting with those of the model; sums are
+// cached by the ids of their operands, as few distinct ones ever occur
+struct exact_sums_t {
+    std::vector<rational_t> values;
+    std::map<rational_t, size_t> ids;
+    std::vector<size_t> id_of_prob; // of the model's `exact_probs`
+    std::unordered_map<std::uint64_t, size_t> cache;
+
+    explicit exact_sums_t(explicit_mdp_t const& model) {
+        for (auto const& p : model.exact_probs)
+            id_of_prob.push_back(id_of(p));
+    }
+    size_t id_of(rational_t const& p) {
+        auto found = ids.emplace(p, values.size());
+        if (found.second)
+            values.push_back(p);
+        return found.first->second;
+    }
+    size_t add(size_t a, size_t b) {
+        if (a > b)
+            std::swap(a, b);
+        auto key = static_cast<std::uint64_t>(a) << 32 | b;
+        auto found = cache.find(key);
+        if (found != cache.end())
+            return found->second;
+        auto id = id_of(values[a] + values[b]);
+        cache.emplace(key, id);
+        return id;
+    }
+};
+
+// the distribution of a choice over blocks, sorted by block: the id of the
+// exact mass of each block, or the mass quantized if it is inexact
+using distribution_t = std::vector<std::pair<size_t, long long>>;
+
+static distribution_t distribution(
+        explicit_mdp_t const& model, size_t c, std::vector<size_t> const& block_of,
+        exact_sums_t& sums) {
+    std::vector<std::pair<size_t, size_t>> mass; // (block, transition)
+    for (auto t=model.transition_begin[c]; t<model.transition_begin[c+1]; ++t)
+        mass.emplace_back(block_of[model.successors[t]], t);
+    std::sort(mass.begin(), mass.end());
+    distribution_t result;
+    for (size_t i=0; i<mass.size();) {
+        auto block = mass[i].first;
+        auto j = i + 1;
+        while (j < mass.size() && mass[j].first == block)
+            ++j;
+        if (!model.is_exact()) {
+            double sum = 0.0;
+            for (; i<j; ++i)
+                sum += model.probs[mass[i].second];
+            result.emplace_back(block, quantize(sum));
+            continue;
+        }
+        auto sum = sums.id_of_prob[model.exact_of[mass[i].second]];
+        for (++i; i<j; ++i)
+            sum = sums.add(sum, sums.id_of_prob[model.exact_of[mass[i].second]]);
+        result.emplace_back(block, sum);
+    }
+    return result;
+}
+
+using signature_t = std::pair<size_t, std::vector<distribution_t>>;
+
+struct signature_hash_t {
+    size_t operator()(signature_t const& signature) const {
+        size_t h = signature.first;
+        auto mix = [&h](size_t v) {
+            h ^= std::hash<size_t>{}(v) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        };
+        for (auto const& d : signature.second) {
+            mix(d.size());
+            for (auto const& entry : d) {
+                mix(entry.first);
+                mix(static_cast<size_t>(entry.second));
+            }
+        }
+        return h;
+    }
+};
+
+// signature-based partition refinement: a state's signature is its block
+// together with the set of distributions its choices induce over blocks;
+// blocks are numbered by their first state, so the initial state stays 0
+quotient_t bisimulation_quotient(explicit_mdp_t const& model, std::vector<bool> const& target) {
+    size_t n = model.state_count();
+    exact_sums_t sums{model};
+    std::vector<size_t> block_of(n);
+    size_t block_count = 0;
+    {
+        std::map<bool, size_t> ids;
+        for (size_t s=0; s<n; ++s)
+            block_of[s] = ids.emplace(target[s], ids.size()).first->second;
+        block_count = ids.size();
+    }
+
+    while (true) {
+        std::unordered_map<signature_t, size_t, signature_hash_t> ids;
+        std::vector<size_t> next(n);
+        for (size_t s=0; s<n; ++s) {
+            signature_t signature{block_of[s], {}};
+            for (auto c=model.choice_begin[s]; c<model.choice_begin[s+1]; ++c)
+                signature.second.push_back(distribution(model, c, block_of, sums));
+            std::sort(signature.second.begin(), signature.second.end());
+            signature.second.erase(
+                    std::unique(signature.second.begin(), signature.second.end()),
+                    signature.second.end());
+            next[s] = ids.emplace(std::move(signature), ids.size()).first->second;
+        }
+        block_of = std::move(next);
+        // refinement only splits blocks, so an equal count is a fixpoint
+        if (ids.size() == block_count)
+            break;
+        block_count = ids.size();
+    }
+
+    quotient_t result;
+    result.block_of = block_of;
+    result.target.assign(block_count, false);
+    auto& q = result.model;
+    q.variables = model.variables;
+    q.choice_begin.push_back(0);
+    q.transition_begin.push_back(0);
+    // blocks are emitted in order of their first state, i.e. of their id
+    std::vector<bool> done(block_count, false);
+    for (size_t s=0; s<n; ++s) {
+        auto b = block_of[s];
+        if (done[b])
+            continue;
+        done[b] = true;
+        q.states.push_back(model.states[s]);
+        result.target[b] = target[s];
+        // one choice per distinct distribution, with the summed probabilities
+        std::set<distribution_t> seen;
+        for (auto c=model.choice_begin[s]; c<model.choice_begin[s+1]; ++c) {
+            auto d = distribution(model, c, block_of, sums);
+            if (!seen.insert(d).second)
+                continue;
+            if (model.is_exact()) {
+                for (auto const& entry : d) {
+                    q.successors.push_back(entry.first);
+                    q.probs.push_back(sums.values[entry.second].convert_to<double>());
+                    q.exact_of.push_back((std::uint32_t)entry.second);
+                }
+                q.transition_begin.push_back(q.successors.size());
+                continue;
+            }
+            std::map<size_t, double> mass;
+            for (auto t=model.transition_begin[c]; t<model.transition_begin[c+1]; ++t)
+                mass[block_of[model.successors[t]]] += model.probs[t];
+            for (auto const& m : mass) {
+                q.successors.push_back(m.first);
+                q.probs.push_back(m.second);
+            }
+            q.transition_begin.push_back(q.successors.size());
+        }
+        q.choice_begin.push_back(q.transition_begin.size() - 1);
+    }
+    if (model.is_exact())
+        q.exact_probs = std::move(sums.values);
+    return result;
+}
+
+}
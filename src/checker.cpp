@@ -0,0 +1,414 @@
+#include <algorithm>
+#include <stdexcept>
+#include <iterator>
+#include <memory>
+
+#include "checker.hpp"
+#include "PCTL.hpp"
+#include "logic.hpp"
+#include "symbolic.hpp"
+
+namespace checker {
+
+using mdp::explicit_mdp_t;
+
+static ptr<mdp::expr_t> to_mdp_expr(logic::term_t const&);
+
+static ptr<mdp::expr_t> to_mdp_binop(
+        logic::term_t const& lhs, logic::term_t const& rhs, mdp::binop_kind_t kind) {
+    return make<mdp::binop_expr_t>(to_mdp_expr(lhs), to_mdp_expr(rhs), kind);
+}
+
+static ptr<mdp::expr_t> to_mdp_expr(logic::term_t const& term) {
+    using namespace logic;
+    using mdp::binop_kind_t;
+    switch (term.kind()) {
+    case term_kind_t::Var:
+        return make<mdp::var_expr_t>(cast<var_term_t>(term).name);
+    case term_kind_t::Int:
+        return make<mdp::int_expr_t>(cast<int_term_t>(term).n);
+    case term_kind_t::Add:
+        return to_mdp_binop(*cast<add_term_t>(term).lhs, *cast<add_term_t>(term).rhs, binop_kind_t::Add);
+    case term_kind_t::Sub:
+        return to_mdp_binop(*cast<sub_term_t>(term).lhs, *cast<sub_term_t>(term).rhs, binop_kind_t::Sub);
+    case term_kind_t::Mul:
+        return to_mdp_binop(*cast<mul_term_t>(term).lhs, *cast<mul_term_t>(term).rhs, binop_kind_t::Mul);
+    case term_kind_t::Div:
+        return to_mdp_binop(*cast<div_term_t>(term).lhs, *cast<div_term_t>(term).rhs, binop_kind_t::Div);
+    case term_kind_t::Prob:
+        throw std::runtime_error{"nested Prob is not supported"};
+    }
+    throw std::logic_error{"unreachable"};
+}
+
+// state formula inside `Prob(...)`
+static ptr<mdp::expr_t> to_mdp_expr(logic::formula_t const& f) {
+    using namespace logic;
+    using mdp::binop_kind_t;
+    auto binop = [](ptr<formula_t> const& lhs, ptr<formula_t> const& rhs, binop_kind_t kind) {
+        return make<mdp::binop_expr_t>(to_mdp_expr(*lhs), to_mdp_expr(*rhs), kind);
+    };
+    switch (f.kind()) {
+    case formula_kind_t::Var:
+        return make<mdp::var_expr_t>(cast<var_formula_t>(f).name);
+    case formula_kind_t::Bot:
+        return make<mdp::bool_expr_t>(false);
+    case formula_kind_t::Top:
+        return make<mdp::bool_expr_t>(true);
+    case formula_kind_t::Neg:
+        return make<mdp::neg_expr_t>(to_mdp_expr(*cast<neg_formula_t>(f).inner));
+    case formula_kind_t::And:
+        return binop(cast<and_formula_t>(f).lhs, cast<and_formula_t>(f).rhs, binop_kind_t::And);
+    case formula_kind_t::Or:
+        return binop(cast<or_formula_t>(f).lhs, cast<or_formula_t>(f).rhs, binop_kind_t::Or);
+    case formula_kind_t::Impl:
+        return binop(cast<impl_formula_t>(f).lhs, cast<impl_formula_t>(f).rhs, binop_kind_t::Impl);
+    case formula_kind_t::Eq:
+        return to_mdp_binop(*cast<eq_formula_t>(f).lhs, *cast<eq_formula_t>(f).rhs, binop_kind_t::Eq);
+    case formula_kind_t::Lt:
+        return to_mdp_binop(*cast<less_formula_t>(f).lhs, *cast<less_formula_t>(f).rhs, binop_kind_t::Lt);
+    case formula_kind_t::Leq:
+        return to_mdp_binop(*cast<leq_formula_t>(f).lhs, *cast<leq_formula_t>(f).rhs, binop_kind_t::Leq);
+    case formula_kind_t::Geq:
+        return to_mdp_binop(*cast<geq_formula_t>(f).lhs, *cast<geq_formula_t>(f).rhs, binop_kind_t::Geq);
+    case formula_kind_t::Gt:
+        return to_mdp_binop(*cast<greater_formula_t>(f).lhs, *cast<greater_formula_t>(f).rhs, binop_kind_t::Gt);
+    }
+    throw std::logic_error{"unreachable"};
+}
+
+// closed interval of exact rationals; probabilities enter as their bounds
+struct interval_t {
+    rational_t lower, upper;
+
+    explicit interval_t(rational_t x) :
+        lower{x}, upper{x}
+    {}
+    interval_t(rational_t lower, rational_t upper) :
+        lower{std::move(lower)}, upper{std::move(upper)}
+    {}
+};
+
+static interval_t operator+(interval_t const& a, interval_t const& b) {
+    return interval_t{a.lower + b.lower, a.upper + b.upper};
+}
+
+static interval_t operator-(interval_t const& a, interval_t const& b) {
+    return interval_t{a.lower - b.upper, a.upper - b.lower};
+}
+
+static interval_t operator*(interval_t const& a, interval_t const& b) {
+    rational_t products[] = {a.lower * b.lower, a.lower * b.upper, a.upper * b.lower, a.upper * b.upper};
+    return interval_t{
+        *std::min_element(std::begin(products), std::end(products)),
+        *std::max_element(std::begin(products), std::end(products))};
+}
+
+static interval_t operator/(interval_t const& a, interval_t const& b) {
+    if (b.lower <= 0 && 0 <= b.upper)
+        throw std::runtime_error{"division by a term that may be zero"};
+    return a * interval_t{1 / b.upper, 1 / b.lower};
+}
+
+// Kleene's three-valued connectives
+static verdict_t operator!(verdict_t v) {
+    switch (v) {
+    case verdict_t::True: return verdict_t::False;
+    case verdict_t::False: return verdict_t::True;
+    case verdict_t::Unknown: return verdict_t::Unknown;
+    }
+    throw std::logic_error{"unreachable"};
+}
+
+static verdict_t operator&&(verdict_t a, verdict_t b) {
+    if (a == verdict_t::False || b == verdict_t::False)
+        return verdict_t::False;
+    if (a == verdict_t::True && b == verdict_t::True)
+        return verdict_t::True;
+    return verdict_t::Unknown;
+}
+
+static verdict_t operator||(verdict_t a, verdict_t b) {
+    return !(!a && !b);
+}
+
+static verdict_t verdict_of(bool b) {
+    return b ? verdict_t::True : verdict_t::False;
+}
+
+// a verdict is only given when it holds for every pair of values
+static verdict_t compare(interval_t const& a, interval_t const& b, comparison_t op) {
+    switch (op) {
+    case comparison_t::Eq:
+        if (a.upper < b.lower || b.upper < a.lower)
+            return verdict_t::False;
+        if (a.lower == a.upper && b.lower == b.upper)
+            return verdict_t::True;
+        return verdict_t::Unknown;
+    case comparison_t::Lt:
+        if (a.upper < b.lower)
+            return verdict_t::True;
+        if (a.lower >= b.upper)
+            return verdict_t::False;
+        return verdict_t::Unknown;
+    case comparison_t::Leq:
+        if (a.upper <= b.lower)
+            return verdict_t::True;
+        if (a.lower > b.upper)
+            return verdict_t::False;
+        return verdict_t::Unknown;
+    case comparison_t::Geq:
+        return compare(b, a, comparison_t::Leq);
+    case comparison_t::Gt:
+        return compare(b, a, comparison_t::Lt);
+    }
+    throw std::logic_error{"unreachable"};
+}
+
+verdict_t threshold_t::decide(rational_t const& lower, rational_t const& upper) const {
+    return compare(interval_t{lower, upper}, interval_t{bound}, op);
+}
+
+static comparison_t comparison_of(logic::formula_kind_t kind) {
+    using logic::formula_kind_t;
+    switch (kind) {
+    case formula_kind_t::Lt: return comparison_t::Lt;
+    case formula_kind_t::Leq: return comparison_t::Leq;
+    case formula_kind_t::Eq: return comparison_t::Eq;
+    case formula_kind_t::Geq: return comparison_t::Geq;
+    case formula_kind_t::Gt: return comparison_t::Gt;
+    default:
+        throw std::logic_error{"not a comparison"};
+    }
+}
+
+// `a op b` iff `b (flip op) a`
+static comparison_t flip(comparison_t op) {
+    switch (op) {
+    case comparison_t::Lt: return comparison_t::Gt;
+    case comparison_t::Leq: return comparison_t::Geq;
+    case comparison_t::Eq: return comparison_t::Eq;
+    case comparison_t::Geq: return comparison_t::Leq;
+    case comparison_t::Gt: return comparison_t::Lt;
+    }
+    throw std::logic_error{"unreachable"};
+}
+
+static bool has_prob(logic::term_t const& term) {
+    using namespace logic;
+    switch (term.kind()) {
+    case term_kind_t::Var:
+    case term_kind_t::Int:
+        return false;
+    case term_kind_t::Add:
+        return has_prob(*cast<add_term_t>(term).lhs) || has_prob(*cast<add_term_t>(term).rhs);
+    case term_kind_t::Sub:
+        return has_prob(*cast<sub_term_t>(term).lhs) || has_prob(*cast<sub_term_t>(term).rhs);
+    case term_kind_t::Mul:
+        return has_prob(*cast<mul_term_t>(term).lhs) || has_prob(*cast<mul_term_t>(term).rhs);
+    case term_kind_t::Div:
+        return has_prob(*cast<div_term_t>(term).lhs) || has_prob(*cast<div_term_t>(term).rhs);
+    case term_kind_t::Prob:
+        return true;
+    }
+    throw std::logic_error{"unreachable"};
+}
+
+// evaluates the refinement formula in the initial state.
+// `pos` selects Pmin or Pmax for `Prob` the same way as `logic::output`.
+struct formula_checker_t {
+    mdp::mdp_t const& mdp;
+    mdp::successor_generator_t const& generator;
+    int accept;
+    util::optional<int> overflow;
+    options_t const& options;
+    mutable util::optional<explicit_mdp_t> model; // explored on first use
+    mutable std::unique_ptr<symbolic_mdp_t> symbolic; // encoded on first use
+
+    explicit_mdp_t const& full_model() const {
+        if (!model)
+            model = mdp::explore(generator);
+        return *model;
+    }
+
+    double eval_initial(mdp::expr_t const& e) const {
+        return generator.compile(e).eval(generator.initial_state());
+    }
+
+    interval_t solve(
+            explicit_mdp_t const& m,
+            std::vector<bool> const& target,
+            objective_t objective,
+            util::optional<threshold_t> const& threshold) const {
+        if (m.state_count() <= options.exact_threshold)
+            return interval_t{reach_exact(m, target, objective)[0]};
+        auto bounds = reach_bounds(m, target, objective, options, threshold);
+        interval_t value{to_rational(bounds.lower[0]), to_rational(bounds.upper[0])};
+        // the rounding error of one pass over an acyclic model straddles a
+        // threshold the probability (nearly) equals; an exact pass decides it
+        bool undecided = threshold && threshold->decide(value.lower, value.upper) == verdict_t::Unknown;
+        if (undecided && options.exact_threshold > 0 && topological_order(m))
+            return interval_t{reach_exact(m, target, objective)[0]};
+        return value;
+    }
+
+    // solves growing partial models: unexpanded states are failures for
+    // the lower bound and successes for the upper bound
+    interval_t solve_on_the_fly(
+            mdp::compiled_expr_t const& target,
+            objective_t objective,
+            util::optional<threshold_t> const& threshold) const {
+        mdp::partial_explorer_t explorer{generator, target};
+        auto precision = to_rational(options.precision);
+        for (size_t batch = 1024; ; batch *= 2) {
+            explorer.expand(batch);
+            std::vector<bool> frontier;
+            auto partial = explorer.snapshot(frontier);
+            auto pessimistic = explorer.stopped();
+            if (explorer.complete())
+                return solve(partial, pessimistic, objective, threshold);
+            auto optimistic = pessimistic;
+            for (size_t s=0; s<partial.state_count(); ++s)
+                optimistic[s] = optimistic[s] || frontier[s];
+            interval_t value{
+                solve(partial, pessimistic, objective, threshold).lower,
+                solve(partial, optimistic, objective, threshold).upper};
+            if (threshold && threshold->decide(value.lower, value.upper) != verdict_t::Unknown)
+                return value;
+            if (value.upper - value.lower < precision)
+                return value;
+        }
+    }
+
+    interval_t prob(
+            logic::formula_t const& inner, bool pos,
+            util::optional<threshold_t> const& threshold = util::nullopt) const {
+        ptr<mdp::expr_t> target_expr = to_mdp_expr(inner);
+        auto const& vars = generator.variables();
+        // without `location` the program never moves from its accept location
+        if (std::find(vars.begin(), vars.end(), "location") != vars.end()) {
+            target_expr = make<mdp::binop_expr_t>(
+                    make<mdp::binop_expr_t>(
+                        make<mdp::var_expr_t>("location"),
+                        make<mdp::int_expr_t>(accept),
+                        mdp::binop_kind_t::Eq),
+                    target_expr,
+                    mdp::binop_kind_t::And);
+        }
+        // a run that overflowed a stack may have ended with any value
+        if (!pos && overflow) {
+            target_expr = make<mdp::binop_expr_t>(
+                    target_expr,
+                    make<mdp::binop_expr_t>(
+                        make<mdp::var_expr_t>("location"),
+                        make<mdp::int_expr_t>(*overflow),
+                        mdp::binop_kind_t::Eq),
+                    mdp::binop_kind_t::Or);
+        }
+        auto objective = pos ? objective_t::Min : objective_t::Max;
+        if (options.engine == engine_t::Symbolic) {
+            if (!symbolic)
+                symbolic = std::make_unique<symbolic_mdp_t>(mdp);
+            auto bounds = symbolic->reach(symbolic->encode(*target_expr), objective, options, threshold);
+            return interval_t{to_rational(bounds.first), to_rational(bounds.second)};
+        }
+        auto compiled = generator.compile(*target_expr);
+        if (options.exploration == exploration_t::OnTheFly)
+            return solve_on_the_fly(compiled, objective, threshold);
+
+        auto const& m = full_model();
+        std::vector<bool> target(m.state_count());
+        for (size_t s=0; s<m.state_count(); ++s)
+            target[s] = compiled.eval(m.states[s]) != 0;
+        if (options.bisimulation) {
+            auto quotient = bisimulation_quotient(m, target);
+            return solve(quotient.model, quotient.target, objective, threshold);
+        }
+        return solve(m, target, objective, threshold);
+    }
+
+    interval_t eval(logic::term_t const& term, bool pos) const {
+        using namespace logic;
+        switch (term.kind()) {
+        case term_kind_t::Var:
+        case term_kind_t::Int:
+            return interval_t{to_rational(eval_initial(*to_mdp_expr(term)))};
+        case term_kind_t::Add:
+            return eval(*cast<add_term_t>(term).lhs, pos) + eval(*cast<add_term_t>(term).rhs, pos);
+        case term_kind_t::Sub:
+            return eval(*cast<sub_term_t>(term).lhs, pos) - eval(*cast<sub_term_t>(term).rhs, pos);
+        case term_kind_t::Mul:
+            return eval(*cast<mul_term_t>(term).lhs, pos) * eval(*cast<mul_term_t>(term).rhs, pos);
+        case term_kind_t::Div:
+            return eval(*cast<div_term_t>(term).lhs, pos) / eval(*cast<div_term_t>(term).rhs, pos);
+        case term_kind_t::Prob:
+            return prob(*cast<prob_term_t>(term).inner, pos);
+        }
+        throw std::logic_error{"unreachable"};
+    }
+
+    // `lhs kind rhs` with the polarities of both sides; a bare `Prob`
+    // compared against a Prob-free term is handed the threshold so that
+    // iteration stops as soon as it is decided
+    verdict_t compare(
+            logic::term_t const& lhs, bool lhs_pos,
+            logic::term_t const& rhs, bool rhs_pos,
+            logic::formula_kind_t kind) const {
+        using namespace logic;
+        auto op = comparison_of(kind);
+        if (lhs.kind() == term_kind_t::Prob && !has_prob(rhs)) {
+            // a Prob-free term evaluates to a single point
+            auto bound = eval(rhs, rhs_pos);
+            threshold_t threshold{op, bound.lower};
+            auto value = prob(*cast<prob_term_t>(lhs).inner, lhs_pos, threshold);
+            return threshold.decide(value.lower, value.upper);
+        }
+        if (rhs.kind() == term_kind_t::Prob && !has_prob(lhs)) {
+            auto bound = eval(lhs, lhs_pos);
+            threshold_t threshold{flip(op), bound.lower};
+            auto value = prob(*cast<prob_term_t>(rhs).inner, rhs_pos, threshold);
+            return threshold.decide(value.lower, value.upper);
+        }
+        return checker::compare(eval(lhs, lhs_pos), eval(rhs, rhs_pos), op);
+    }
+
+    verdict_t eval(logic::formula_t const& f, bool pos) const {
+        using namespace logic;
+        switch (f.kind()) {
+        case formula_kind_t::Var:
+            return verdict_of(eval_initial(*to_mdp_expr(f)) != 0);
+        case formula_kind_t::Bot:
+            return verdict_t::False;
+        case formula_kind_t::Top:
+            return verdict_t::True;
+        case formula_kind_t::Neg:
+            return !eval(*cast<neg_formula_t>(f).inner, pos);
+        case formula_kind_t::And:
+            return eval(*cast<and_formula_t>(f).lhs, pos) && eval(*cast<and_formula_t>(f).rhs, pos);
+        case formula_kind_t::Or:
+            return eval(*cast<or_formula_t>(f).lhs, pos) || eval(*cast<or_formula_t>(f).rhs, pos);
+        case formula_kind_t::Impl:
+            return !eval(*cast<impl_formula_t>(f).lhs, !pos) || eval(*cast<impl_formula_t>(f).rhs, pos);
+        case formula_kind_t::Eq:
+            return compare(*cast<eq_formula_t>(f).lhs, pos, *cast<eq_formula_t>(f).rhs, pos, f.kind());
+        case formula_kind_t::Lt:
+            return compare(*cast<less_formula_t>(f).lhs, !pos, *cast<less_formula_t>(f).rhs, pos, f.kind());
+        case formula_kind_t::Leq:
+            return compare(*cast<leq_formula_t>(f).lhs, !pos, *cast<leq_formula_t>(f).rhs, pos, f.kind());
+        case formula_kind_t::Geq:
+            return compare(*cast<geq_formula_t>(f).lhs, pos, *cast<geq_formula_t>(f).rhs, !pos, f.kind());
+        case formula_kind_t::Gt:
+            return compare(*cast<greater_formula_t>(f).lhs, pos, *cast<greater_formula_t>(f).rhs, !pos, f.kind());
+        }
+        throw std::logic_error{"unreachable"};
+    }
+};
+
+verdict_t check(mdp::mdp_t const& mdp, pctl::pctl_t const& pctl, options_t const& options) {
+    mdp::successor_generator_t generator{mdp};
+    formula_checker_t checker{
+        mdp, generator, pctl.final_location, pctl.overflow_location, options, util::nullopt, nullptr};
+    return checker.eval(*pctl.constraint, true);
+}
+
+}
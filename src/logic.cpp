@@ -157,6 +157,68 @@ ptr<formula_t> subst(
     }
 }
 
+static void collect_variables(formula_t const&, std::unordered_set<std::string>&);
+
+static void collect_variables(term_t const& t, std::unordered_set<std::string>& names) {
+    switch (t.kind()) {
+    case term_kind_t::Add:
+    case term_kind_t::Sub:
+    case term_kind_t::Mul:
+    case term_kind_t::Div:
+        collect_variables(*cast<binop_term_t>(t).lhs, names);
+        collect_variables(*cast<binop_term_t>(t).rhs, names);
+        return;
+    case term_kind_t::Prob:
+        collect_variables(*cast<prob_term_t>(t).inner, names);
+        return;
+    case term_kind_t::Var:
+        names.insert(cast<var_term_t>(t).name);
+        return;
+    case term_kind_t::Int:
+        return;
+    }
+}
+
+static void collect_variables(formula_t const& f, std::unordered_set<std::string>& names) {
+    switch (f.kind()) {
+    case formula_kind_t::Var:
+        names.insert(cast<var_formula_t>(f).name);
+        return;
+    case formula_kind_t::Neg:
+        collect_variables(*cast<neg_formula_t>(f).inner, names);
+        return;
+    case formula_kind_t::And:
+        collect_variables(*cast<and_formula_t>(f).lhs, names);
+        collect_variables(*cast<and_formula_t>(f).rhs, names);
+        return;
+    case formula_kind_t::Or:
+        collect_variables(*cast<or_formula_t>(f).lhs, names);
+        collect_variables(*cast<or_formula_t>(f).rhs, names);
+        return;
+    case formula_kind_t::Impl:
+        collect_variables(*cast<impl_formula_t>(f).lhs, names);
+        collect_variables(*cast<impl_formula_t>(f).rhs, names);
+        return;
+    case formula_kind_t::Eq:
+    case formula_kind_t::Lt:
+    case formula_kind_t::Leq:
+    case formula_kind_t::Geq:
+    case formula_kind_t::Gt:
+        collect_variables(*cast<binop_formula_t>(f).lhs, names);
+        collect_variables(*cast<binop_formula_t>(f).rhs, names);
+        return;
+    case formula_kind_t::Top:
+    case formula_kind_t::Bot:
+        return;
+    }
+}
+
+std::unordered_set<std::string> free_variables(formula_t const& f) {
+    std::unordered_set<std::string> names;
+    collect_variables(f, names);
+    return names;
+}
+
 std::string to_debug_string(domain_kind_t kind) {
     switch (kind) {
     case domain_kind_t::Int:
@@ -245,7 +307,7 @@ std::string to_debug_string(predicate_t const& pred) {
         to_debug_string(*pred.body) + ")";
 }
 
-std::string output(term_t const& term, int accept, bool pos) {
+std::string output(term_t const& term, int accept, bool pos, bool deterministic, util::optional<int> overflow) {
     switch (term.kind()) {
     case term_kind_t::Var:
         return cast<var_term_t>(term).name;
@@ -253,38 +315,38 @@ std::string output(term_t const& term, int accept, bool pos) {
         return std::to_string(cast<int_term_t>(term).n);
     case term_kind_t::Add:
         return "(" +
-            output(*cast<add_term_t>(term).lhs, accept, pos) + "+" +
-            output(*cast<add_term_t>(term).rhs, accept, pos) + ")";
+            output(*cast<add_term_t>(term).lhs, accept, pos, deterministic, overflow) + "+" +
+            output(*cast<add_term_t>(term).rhs, accept, pos, deterministic, overflow) + ")";
     case term_kind_t::Sub:
         return "(" +
-            output(*cast<sub_term_t>(term).lhs, accept, pos) + "-" +
-            output(*cast<sub_term_t>(term).rhs, accept, pos) + ")";
+            output(*cast<sub_term_t>(term).lhs, accept, pos, deterministic, overflow) + "-" +
+            output(*cast<sub_term_t>(term).rhs, accept, pos, deterministic, overflow) + ")";
     case term_kind_t::Mul:
         return "(" +
-            output(*cast<mul_term_t>(term).lhs, accept, pos) + "*" +
-            output(*cast<mul_term_t>(term).rhs, accept, pos) + ")";
+            output(*cast<mul_term_t>(term).lhs, accept, pos, deterministic, overflow) + "*" +
+            output(*cast<mul_term_t>(term).rhs, accept, pos, deterministic, overflow) + ")";
     case term_kind_t::Div:
         return "(" +
-            output(*cast<div_term_t>(term).lhs, accept, pos) + "/" +
-            output(*cast<div_term_t>(term).rhs, accept, pos) + ")";
+            output(*cast<div_term_t>(term).lhs, accept, pos, deterministic, overflow) + "/" +
+            output(*cast<div_term_t>(term).rhs, accept, pos, deterministic, overflow) + ")";
     case term_kind_t::Prob: {
-        std::string pmin =
-            format("Pmin=? [F location={} & {}]",
-                accept,
-                output(*cast<prob_term_t>(term).inner, accept, pos));
-        std::string pmax =
-            format("Pmax=? [F location={} & {}]",
-                accept,
-                output(*cast<prob_term_t>(term).inner, accept, pos));
+        auto inner = output(*cast<prob_term_t>(term).inner, accept, pos, deterministic, overflow);
+        // a run that overflowed a stack may have ended with any value, so
+        // it satisfies upper bounds (`!pos`) and violates lower bounds
+        auto target = !pos && overflow ?
+            format("((location={} & {}) | location={})", accept, inner, *overflow) :
+            format("location={} & {}", accept, inner);
+        if (deterministic)
+            return format("P=? [F {}]", target);
         if (pos)
-            return pmin;
+            return format("Pmin=? [F {}]", target);
         else
-            return pmax;
+            return format("Pmax=? [F {}]", target);
         }
     }
 }
 
-std::string output(formula_t const& f, int accept, bool pos) {
+std::string output(formula_t const& f, int accept, bool pos, bool deterministic, util::optional<int> overflow) {
     switch (f.kind()) {
     case formula_kind_t::Var:
         return cast<var_formula_t>(f).name;
@@ -293,40 +355,40 @@ std::string output(formula_t const& f, int accept, bool pos) {
     case formula_kind_t::Top:
         return "(1=1)";
     case formula_kind_t::Neg:
-        return "!("  + output(*cast<neg_formula_t>(f).inner, accept, pos) + ")";
+        return "!("  + output(*cast<neg_formula_t>(f).inner, accept, pos, deterministic, overflow) + ")";
     case formula_kind_t::And:
         return "(" +
-            output(*cast<and_formula_t>(f).lhs, accept, pos) + "&" +
-            output(*cast<and_formula_t>(f).rhs, accept, pos) + ")";
+            output(*cast<and_formula_t>(f).lhs, accept, pos, deterministic, overflow) + "&" +
+            output(*cast<and_formula_t>(f).rhs, accept, pos, deterministic, overflow) + ")";
         break;
     case formula_kind_t::Or:
         return "(" +
-            output(*cast<or_formula_t>(f).lhs, accept, pos) + "|" +
-            output(*cast<or_formula_t>(f).rhs, accept, pos) + ")";
+            output(*cast<or_formula_t>(f).lhs, accept, pos, deterministic, overflow) + "|" +
+            output(*cast<or_formula_t>(f).rhs, accept, pos, deterministic, overflow) + ")";
     case formula_kind_t::Impl:
         return "(" +
-            output(*cast<impl_formula_t>(f).lhs, accept, !pos) + "=>" +
-            output(*cast<impl_formula_t>(f).rhs, accept, pos) + ")";
+            output(*cast<impl_formula_t>(f).lhs, accept, !pos, deterministic, overflow) + "=>" +
+            output(*cast<impl_formula_t>(f).rhs, accept, pos, deterministic, overflow) + ")";
     case formula_kind_t::Eq:
         return "(" +
-            output(*cast<eq_formula_t>(f).lhs, accept, pos) + "=" +
-            output(*cast<eq_formula_t>(f).rhs, accept, pos) + ")";
+            output(*cast<eq_formula_t>(f).lhs, accept, pos, deterministic, overflow) + "=" +
+            output(*cast<eq_formula_t>(f).rhs, accept, pos, deterministic, overflow) + ")";
     case formula_kind_t::Lt:
         return "(" +
-            output(*cast<less_formula_t>(f).lhs, accept, !pos) + "<" +
-            output(*cast<less_formula_t>(f).rhs, accept, pos) + ")";
+            output(*cast<less_formula_t>(f).lhs, accept, !pos, deterministic, overflow) + "<" +
+            output(*cast<less_formula_t>(f).rhs, accept, pos, deterministic, overflow) + ")";
     case formula_kind_t::Leq:
         return "(" +
-            output(*cast<leq_formula_t>(f).lhs, accept, !pos) + "<=" +
-            output(*cast<leq_formula_t>(f).rhs, accept, pos) + ")";
+            output(*cast<leq_formula_t>(f).lhs, accept, !pos, deterministic, overflow) + "<=" +
+            output(*cast<leq_formula_t>(f).rhs, accept, pos, deterministic, overflow) + ")";
     case formula_kind_t::Geq:
         return "(" +
-            output(*cast<geq_formula_t>(f).lhs, accept, pos) + ">=" +
-            output(*cast<geq_formula_t>(f).rhs, accept, !pos) + ")";
+            output(*cast<geq_formula_t>(f).lhs, accept, pos, deterministic, overflow) + ">=" +
+            output(*cast<geq_formula_t>(f).rhs, accept, !pos, deterministic, overflow) + ")";
     case formula_kind_t::Gt:
         return "(" +
-            output(*cast<greater_formula_t>(f).lhs, accept, pos) + ">" +
-            output(*cast<greater_formula_t>(f).rhs, accept, !pos) + ")";
+            output(*cast<greater_formula_t>(f).lhs, accept, pos, deterministic, overflow) + ">" +
+            output(*cast<greater_formula_t>(f).rhs, accept, !pos, deterministic, overflow) + ")";
     }
 }
 
@@ -2,6 +2,8 @@
 #include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <stdexcept>
+#include <string>
 
 #include "expr_ast.hpp"
 #include "parser.hpp"
@@ -9,6 +11,7 @@
 #include "typechecker.hpp"
 #include "evaluator.hpp"
 #include "simple_type.hpp"
+#include "checker.hpp"
 
 #include "test.hpp"
 
@@ -23,6 +26,29 @@ void output_parse_error(std::string const& input, size_t pos) {
     std::cout << std::string(line.size(), ' ') << "^" << std::endl;
 }
 
+// the number `text` spells, if all of it is one
+util::optional<double> to_number(std::string const& text) {
+    try {
+        size_t len = 0;
+        double value = std::stod(text, &len);
+        if (len == text.size())
+            return value;
+    } catch (std::logic_error const&) { // invalid_argument or out_of_range
+    }
+    return util::nullopt;
+}
+
+util::optional<long> to_integer(std::string const& text) {
+    try {
+        size_t len = 0;
+        long value = std::stol(text, &len);
+        if (len == text.size())
+            return value;
+    } catch (std::logic_error const&) {
+    }
+    return util::nullopt;
+}
+
 int main(int argc, const char* argv[]) {
     std::srand((unsigned int)time(NULL));
 #ifdef PML_TEST_BUILD
@@ -31,14 +57,84 @@ int main(int argc, const char* argv[]) {
 #endif
 
     using namespace ast;
-    if (argc != 2) {
+    checker::options_t options;
+    std::string filename;
+    for (int i=1; i<argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--engine=prism")
+            options.engine = checker::engine_t::Prism;
+        else if (arg == "--engine=native")
+            options.engine = checker::engine_t::Native;
+        else if (arg == "--engine=symbolic")
+            options.engine = checker::engine_t::Symbolic;
+        else if (arg == "--bisimulation=on")
+            options.bisimulation = true;
+        else if (arg == "--bisimulation=off")
+            options.bisimulation = false;
+        else if (arg == "--exploration=full")
+            options.exploration = checker::exploration_t::Full;
+        else if (arg == "--exploration=on-the-fly")
+            options.exploration = checker::exploration_t::OnTheFly;
+        else if (arg == "--iteration=value")
+            options.iteration = checker::iteration_t::Value;
+        else if (arg == "--iteration=interval")
+            options.iteration = checker::iteration_t::Interval;
+        else if (arg == "--method=jacobi")
+            options.method = checker::method_t::Jacobi;
+        else if (arg == "--method=gauss-seidel")
+            options.method = checker::method_t::GaussSeidel;
+        else if (arg == "--method=sor")
+            options.method = checker::method_t::SOR;
+        else if (arg.compare(0, 8, "--omega=") == 0) {
+            auto omega = to_number(arg.substr(8));
+            if (!omega || *omega <= 0 || *omega >= 2) {
+                std::cout << "invalid option : " << arg << " (expected a number between 0 and 2)" << std::endl;
+                return -1;
+            }
+            options.omega = *omega;
+        } else if (arg.compare(0, 12, "--precision=") == 0) {
+            auto precision = to_number(arg.substr(12));
+            if (!precision || *precision <= 0) {
+                std::cout << "invalid option : " << arg << " (expected a positive number)" << std::endl;
+                return -1;
+            }
+            options.precision = *precision;
+        } else if (arg.compare(0, 18, "--exact-threshold=") == 0) {
+            auto threshold = to_integer(arg.substr(18));
+            if (!threshold || *threshold < 0) {
+                std::cout << "invalid option : " << arg << " (expected a count of states)" << std::endl;
+                return -1;
+            }
+            options.exact_threshold = static_cast<size_t>(*threshold);
+        } else if (arg.compare(0, 10, "--threads=") == 0) {
+            auto threads = to_integer(arg.substr(10));
+            if (!threads || *threads < 0 || *threads > 4096) {
+                std::cout << "invalid option : " << arg << " (expected 0 to 4096 threads)" << std::endl;
+                return -1;
+            }
+            options.threads = static_cast<unsigned>(*threads);
+        } else if (arg.compare(0, 12, "--max-depth=") == 0) {
+            // a recursive call needs a frame besides the one it returns to
+            auto depth = to_integer(arg.substr(12));
+            if (!depth || *depth < 2 || *depth > 1024) {
+                std::cout << "invalid option : " << arg << " (expected a depth from 2 to 1024)" << std::endl;
+                return -1;
+            }
+            options.max_depth = static_cast<int>(*depth);
+        } else if (arg.compare(0, 2, "--") == 0) {
+            std::cout << "unknown option : " << arg << std::endl;
+            return -1;
+        } else
+            filename = arg;
+    }
+    if (filename.empty()) {
         std::cout << "[filename] required!" << std::endl;
         return -1;
     }
 
-    std::ifstream input{argv[1]};
+    std::ifstream input{filename};
     if (input.fail()) {
-        std::cout << "file open error : " << argv[1] << std::endl;
+        std::cout << "file open error : " << filename << std::endl;
         return -1;
     }
 
@@ -47,7 +143,7 @@ int main(int argc, const char* argv[]) {
     // TODO: be more elegant
     std::cout << "parsing .. " << std::flush;
     parser::parse(input_str).case_of(
-        ok >> [](ptr<ast::expr_t> const& expr){
+        ok >> [&](ptr<ast::expr_t> const& expr){
             std::cout << "passed!" << std::endl;
             std::cout << "type checking .. " << std::endl;
             auto const& simty_result = simty::simple_typing(*expr);
@@ -55,7 +151,7 @@ int main(int argc, const char* argv[]) {
                 std::cout << "failed at simple typing : " << simty_result.error() << std::endl;
                 return;
             }
-            if (!typechecker::typecheck(*expr)) {
+            if (!typechecker::typecheck(*expr, options)) {
                 std::cout << "failed" << std::endl;
                 return;
             }
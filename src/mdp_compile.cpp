@@ -0,0 +1,416 @@
+#include <cmath>
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+#include "mdp_compile.hpp"
+
+namespace mdp {
+
+double compiled_expr_t::eval(state_t const& s) const {
+    if (is_constant())
+        return code[0].value;
+    if (stack_depth <= 16) {
+        double stack[16];
+        return run(stack, s);
+    }
+    std::vector<double> stack(stack_depth);
+    return run(stack.data(), s);
+}
+
+double compiled_expr_t::run(double* stack, state_t const& s) const {
+    double* sp = stack; // points one past the top
+    for (auto const& instr : code) {
+        switch (instr.op) {
+        case opcode_t::Const: *sp++ = instr.value; break;
+        case opcode_t::Load: *sp++ = s[instr.arg]; break;
+        case opcode_t::Not: sp[-1] = !sp[-1]; break;
+        case opcode_t::Mul: --sp; sp[-1] = sp[-1] * sp[0]; break;
+        case opcode_t::Div: --sp; sp[-1] = sp[-1] / sp[0]; break;
+        case opcode_t::Add: --sp; sp[-1] = sp[-1] + sp[0]; break;
+        case opcode_t::Sub: --sp; sp[-1] = sp[-1] - sp[0]; break;
+        case opcode_t::Lt: --sp; sp[-1] = sp[-1] < sp[0]; break;
+        case opcode_t::Leq: --sp; sp[-1] = sp[-1] <= sp[0]; break;
+        case opcode_t::Geq: --sp; sp[-1] = sp[-1] >= sp[0]; break;
+        case opcode_t::Gt: --sp; sp[-1] = sp[-1] > sp[0]; break;
+        case opcode_t::Eq: --sp; sp[-1] = sp[-1] == sp[0]; break;
+        case opcode_t::Neq: --sp; sp[-1] = sp[-1] != sp[0]; break;
+        case opcode_t::And: --sp; sp[-1] = sp[-1] != 0 && sp[0] != 0; break;
+        case opcode_t::Or: --sp; sp[-1] = sp[-1] != 0 || sp[0] != 0; break;
+        case opcode_t::Iff: --sp; sp[-1] = (sp[-1] != 0) == (sp[0] != 0); break;
+        case opcode_t::Impl: --sp; sp[-1] = sp[-1] == 0 || sp[0] != 0; break;
+        case opcode_t::Select: sp -= 2; sp[-1] = sp[-1] != 0 ? sp[0] : sp[1]; break;
+        case opcode_t::Min:
+            sp -= instr.arg - 1;
+            for (std::uint32_t i=0; i+1<instr.arg; ++i)
+                sp[-1] = std::min(sp[-1], sp[i]);
+            break;
+        case opcode_t::Max:
+            sp -= instr.arg - 1;
+            for (std::uint32_t i=0; i+1<instr.arg; ++i)
+                sp[-1] = std::max(sp[-1], sp[i]);
+            break;
+        case opcode_t::Floor: sp[-1] = std::floor(sp[-1]); break;
+        case opcode_t::Ceil: sp[-1] = std::ceil(sp[-1]); break;
+        case opcode_t::Pow: --sp; sp[-1] = std::pow(sp[-1], sp[0]); break;
+        case opcode_t::Mod: --sp; sp[-1] = std::fmod(sp[-1], sp[0]); break;
+        case opcode_t::Log: --sp; sp[-1] = std::log(sp[-1]) / std::log(sp[0]); break;
+        }
+    }
+    return sp[-1];
+}
+
+void compiled_update_t::apply(state_t const& current, state_t& next) const {
+    for (auto const& assign : assignments) {
+        double value = assign.value.eval(current);
+        if (value != std::floor(value))
+            throw std::runtime_error{format("non-integer value {} assigned to slot {}", value, assign.slot)};
+        if (value < assign.min || assign.max < value)
+            throw std::runtime_error{format("value {} of slot {} is out of range", value, assign.slot)};
+        next[assign.slot] = (int)value;
+    }
+}
+
+static opcode_t to_opcode(binop_kind_t kind) {
+    switch (kind) {
+    case binop_kind_t::Mul: return opcode_t::Mul;
+    case binop_kind_t::Div: return opcode_t::Div;
+    case binop_kind_t::Add: return opcode_t::Add;
+    case binop_kind_t::Sub: return opcode_t::Sub;
+    case binop_kind_t::Lt: return opcode_t::Lt;
+    case binop_kind_t::Leq: return opcode_t::Leq;
+    case binop_kind_t::Geq: return opcode_t::Geq;
+    case binop_kind_t::Gt: return opcode_t::Gt;
+    case binop_kind_t::Eq: return opcode_t::Eq;
+    case binop_kind_t::Neq: return opcode_t::Neq;
+    case binop_kind_t::And: return opcode_t::And;
+    case binop_kind_t::Or: return opcode_t::Or;
+    case binop_kind_t::Iff: return opcode_t::Iff;
+    case binop_kind_t::Impl: return opcode_t::Impl;
+    }
+    throw std::logic_error{"unreachable"};
+}
+
+void compiled_mdp_t::emit(expr_t const& e, compiled_expr_t& out, std::uint32_t depth) const {
+    size_t start = out.code.size();
+    out.stack_depth = std::max(out.stack_depth, depth + 1);
+    switch (e.kind()) {
+    case expr_kind_t::Int:
+        out.code.push_back(instr_t{opcode_t::Const, 0, (double)cast<int_expr_t>(e).n});
+        return;
+    case expr_kind_t::Real:
+        out.code.push_back(instr_t{opcode_t::Const, 0, cast<real_expr_t>(e).d});
+        return;
+    case expr_kind_t::Bool:
+        out.code.push_back(instr_t{opcode_t::Const, 0, (double)cast<bool_expr_t>(e).b});
+        return;
+    case expr_kind_t::Var: {
+        auto const& name = cast<var_expr_t>(e).name;
+        auto slot = slots.find(name);
+        if (slot != slots.end()) {
+            out.code.push_back(instr_t{opcode_t::Load, slot->second, 0});
+            return;
+        }
+        auto cnst = constants.find(name);
+        if (cnst != constants.end()) {
+            out.code.push_back(instr_t{opcode_t::Const, 0, (double)cnst->second});
+            return;
+        }
+        auto formula = formulas.find(name);
+        if (formula != formulas.end()) {
+            emit(*formula->second, out, depth);
+            return;
+        }
+        throw std::runtime_error{"unknown variable: " + name};
+        }
+    case expr_kind_t::Neg:
+        emit(*cast<neg_expr_t>(e).inner, out, depth);
+        out.code.push_back(instr_t{opcode_t::Not, 0, 0});
+        break;
+    case expr_kind_t::BinOp: {
+        auto const& binop = cast<binop_expr_t>(e);
+        emit(*binop.lhs, out, depth);
+        emit(*binop.rhs, out, depth + 1);
+        out.code.push_back(instr_t{to_opcode(binop.binop_kind), 0, 0});
+        break;
+        }
+    case expr_kind_t::If: {
+        auto const& ite = cast<if_expr_t>(e);
+        emit(*ite.cond, out, depth);
+        emit(*ite.true_branch, out, depth + 1);
+        emit(*ite.false_branch, out, depth + 2);
+        out.code.push_back(instr_t{opcode_t::Select, 0, 0});
+        break;
+        }
+    case expr_kind_t::Min:
+    case expr_kind_t::Max: {
+        auto const& elems = e.kind() == expr_kind_t::Min ?
+            cast<min_expr_t>(e).elems :
+            cast<max_expr_t>(e).elems;
+        for (size_t i=0; i<elems.size(); ++i)
+            emit(*elems[i], out, depth + i);
+        auto op = e.kind() == expr_kind_t::Min ? opcode_t::Min : opcode_t::Max;
+        out.code.push_back(instr_t{op, (std::uint32_t)elems.size(), 0});
+        break;
+        }
+    case expr_kind_t::Floor:
+        emit(*cast<floor_expr_t>(e).inner, out, depth);
+        out.code.push_back(instr_t{opcode_t::Floor, 0, 0});
+        break;
+    case expr_kind_t::Ceil:
+        emit(*cast<ceil_expr_t>(e).inner, out, depth);
+        out.code.push_back(instr_t{opcode_t::Ceil, 0, 0});
+        break;
+    case expr_kind_t::Pow:
+        emit(*cast<pow_expr_t>(e).x, out, depth);
+        emit(*cast<pow_expr_t>(e).y, out, depth + 1);
+        out.code.push_back(instr_t{opcode_t::Pow, 0, 0});
+        break;
+    case expr_kind_t::Mod:
+        emit(*cast<mod_expr_t>(e).i, out, depth);
+        emit(*cast<mod_expr_t>(e).n, out, depth + 1);
+        out.code.push_back(instr_t{opcode_t::Mod, 0, 0});
+        break;
+    case expr_kind_t::Log:
+        emit(*cast<log_expr_t>(e).x, out, depth);
+        emit(*cast<log_expr_t>(e).b, out, depth + 1);
+        out.code.push_back(instr_t{opcode_t::Log, 0, 0});
+        break;
+    }
+
+    // fold state-independent subtrees with an exact (integral) result
+    bool reads_state = std::any_of(
+            out.code.begin() + start, out.code.end(),
+            [](instr_t const& instr) { return instr.op == opcode_t::Load; });
+    if (reads_state)
+        return;
+    compiled_expr_t sub;
+    sub.code.assign(out.code.begin() + start, out.code.end());
+    sub.stack_depth = out.stack_depth;
+    double value = sub.eval(state_t{});
+    if (value == std::floor(value)) {
+        out.code.resize(start);
+        out.code.push_back(instr_t{opcode_t::Const, 0, value});
+    }
+}
+
+// integers, constants and the four operations on them, like `1/3`
+util::optional<rational_t> compiled_mdp_t::exact_value(expr_t const& e) const {
+    switch (e.kind()) {
+    case expr_kind_t::Int:
+        return rational_t{cast<int_expr_t>(e).n};
+    case expr_kind_t::Var: {
+        auto const& name = cast<var_expr_t>(e).name;
+        if (slots.count(name))
+            return util::nullopt;
+        auto cnst = constants.find(name);
+        if (cnst != constants.end())
+            return rational_t{cnst->second};
+        auto formula = formulas.find(name);
+        if (formula != formulas.end())
+            return exact_value(*formula->second);
+        return util::nullopt;
+        }
+    case expr_kind_t::BinOp: {
+        auto const& binop = cast<binop_expr_t>(e);
+        auto lhs = exact_value(*binop.lhs);
+        auto rhs = exact_value(*binop.rhs);
+        if (!lhs || !rhs)
+            return util::nullopt;
+        switch (binop.binop_kind) {
+        case binop_kind_t::Mul: return *lhs * *rhs;
+        case binop_kind_t::Add: return *lhs + *rhs;
+        case binop_kind_t::Sub: return *lhs - *rhs;
+        case binop_kind_t::Div:
+            if (*rhs == 0)
+                return util::nullopt;
+            return *lhs / *rhs;
+        default:
+            return util::nullopt;
+        }
+        }
+    default:
+        return util::nullopt;
+    }
+}
+
+compiled_expr_t compiled_mdp_t::compile(expr_t const& e) const {
+    compiled_expr_t result;
+    emit(e, result, 0);
+    return result;
+}
+
+compiled_update_t compiled_mdp_t::compile_update(expr_t const& update) const {
+    compiled_update_t result;
+    std::vector<expr_t const*> conjuncts{&update};
+    while (!conjuncts.empty()) {
+        auto const& e = *conjuncts.back();
+        conjuncts.pop_back();
+        if (e.kind() != expr_kind_t::BinOp)
+            throw std::runtime_error{format("invalid update: {}", e)};
+        auto const& binop = cast<binop_expr_t>(e);
+        if (binop.binop_kind == binop_kind_t::And) {
+            conjuncts.push_back(binop.rhs.get());
+            conjuncts.push_back(binop.lhs.get());
+            continue;
+        }
+        if (binop.binop_kind != binop_kind_t::Eq || binop.lhs->kind() != expr_kind_t::Var)
+            throw std::runtime_error{format("invalid update: {}", e)};
+        auto name = cast<var_expr_t>(*binop.lhs).name;
+        if (name.empty() || name.back() != '\'')
+            throw std::runtime_error{format("invalid update: {}", e)};
+        name.pop_back();
+        auto slot = slots.find(name);
+        if (slot == slots.end())
+            throw std::runtime_error{"unknown variable: " + name};
+        result.assignments.push_back(assignment_t{
+                slot->second, compile(*binop.rhs),
+                bounds[slot->second].min, bounds[slot->second].max});
+    }
+    return result;
+}
+
+compiled_mdp_t::compiled_mdp_t(mdp_t const& mdp) {
+    for (auto const& var : mdp.variables) {
+        slots.emplace(var.name, (std::uint32_t)variables.size());
+        variables.push_back(var.name);
+        if (var.is_int()) {
+            bounds.push_back(var.as_int().bound);
+            initial.push_back(var.as_int().init);
+        } else {
+            bounds.push_back(bound_t{0, 1});
+            initial.push_back(var.as_bool().init);
+        }
+    }
+    for (auto const& cnst : mdp.constants)
+        constants.emplace(cnst.name, cnst.is_int() ? cnst.as_int() : cnst.as_bool());
+    for (auto const& formula : mdp.formulas)
+        formulas.emplace(formula.name, formula.value);
+    auto found = slots.find("location");
+    if (found != slots.end())
+        location_slot = found->second;
+
+    commands.reserve(mdp.commands.size());
+    exact_probs.push_back(1);
+    std::map<rational_t, std::uint32_t> exact_ids{{1, 0}};
+    for (auto const& command : mdp.commands) {
+        compiled_command_t compiled{compile(*command.guard), {}};
+        for (auto const& branch : command.branches) {
+            compiled.branches.push_back(compiled_branch_t{
+                    compile(*branch.prob), compile_update(*branch.update)});
+            if (exact_probs.empty())
+                continue;
+            auto exact = exact_value(*branch.prob);
+            if (!exact) {
+                exact_probs.clear();
+                continue;
+            }
+            auto found = exact_ids.emplace(*exact, (std::uint32_t)exact_probs.size());
+            if (found.second)
+                exact_probs.push_back(*exact);
+            compiled.branches.back().exact = found.first->second;
+        }
+        commands.push_back(std::move(compiled));
+    }
+
+    auto index = mdp.index_commands();
+    for (auto const& p : index.by_location) {
+        if (p.first < 0)
+            throw std::runtime_error{format("negative location {}", p.first)};
+        if ((size_t)p.first >= by_location.size())
+            by_location.resize(p.first + 1);
+        for (auto i : p.second) {
+            by_location[p.first].push_back(i);
+            all_located.push_back(i);
+        }
+    }
+    for (auto& commands_at_loc : by_location)
+        std::sort(commands_at_loc.begin(), commands_at_loc.end());
+    std::sort(all_located.begin(), all_located.end());
+    unlocated.assign(index.unlocated.begin(), index.unlocated.end());
+}
+
+static void collect_loads(compiled_expr_t const& e, std::vector<std::uint32_t>& slots) {
+    for (auto const& instr : e.code) {
+        if (instr.op == opcode_t::Load)
+            slots.push_back(instr.arg);
+    }
+}
+
+std::vector<std::uint32_t> variable_order(compiled_mdp_t const& mdp) {
+    size_t n = mdp.variables.size();
+    // how many commands use both variables
+    std::vector<std::unordered_map<std::uint32_t, size_t>> weight(n);
+    std::vector<size_t> total(n, 0);
+    std::vector<std::uint32_t> used;
+    for (auto const& command : mdp.commands) {
+        used.clear();
+        collect_loads(command.guard, used);
+        for (auto const& branch : command.branches) {
+            collect_loads(branch.prob, used);
+            for (auto const& assign : branch.update.assignments) {
+                used.push_back(assign.slot);
+                collect_loads(assign.value, used);
+            }
+        }
+        std::sort(used.begin(), used.end());
+        used.erase(std::unique(used.begin(), used.end()), used.end());
+        for (auto u : used) {
+            for (auto v : used) {
+                if (u == v)
+                    continue;
+                ++weight[u][v];
+                ++total[u];
+            }
+        }
+    }
+
+    // greedy: next is the variable sharing commands with the most recently
+    // placed one, then with all the placed ones, like Cuthill-McKee
+    std::vector<std::uint32_t> order;
+    std::vector<bool> placed(n, false);
+    std::vector<long> last(n, -1);
+    std::vector<size_t> score(n, 0);
+    auto better = [&](std::uint32_t u, std::uint32_t v) {
+        if (last[u] != last[v])
+            return last[u] > last[v];
+        if (score[u] != score[v])
+            return score[u] > score[v];
+        if (total[u] != total[v])
+            return total[u] > total[v];
+        return u < v;
+    };
+    while (order.size() < n) {
+        std::uint32_t next = 0;
+        if (order.empty() && mdp.location_slot) {
+            next = *mdp.location_slot;
+        } else {
+            while (placed[next])
+                ++next;
+            for (std::uint32_t v=next+1; v<n; ++v) {
+                if (!placed[v] && better(v, next))
+                    next = v;
+            }
+        }
+        placed[next] = true;
+        for (auto const& p : weight[next]) {
+            if (placed[p.first])
+                continue;
+            last[p.first] = (long)order.size();
+            score[p.first] += p.second;
+        }
+        order.push_back(next);
+    }
+    return order;
+}
+
+void order_variables(mdp_t& mdp) {
+    auto order = variable_order(compiled_mdp_t{mdp});
+    std::vector<variable_t> variables;
+    variables.reserve(order.size());
+    for (auto slot : order)
+        variables.push_back(std::move(mdp.variables[slot]));
+    mdp.variables = std::move(variables);
+}
+
+}
@@ -0,0 +1,157 @@
+#include "mdp_explore.hpp"
+
+namespace mdp {
+
+void successor_generator_t::successors(state_t const& s, std::vector<choice_t>& choices) const {
+    choices.clear();
+    auto visit = [&](std::uint32_t i) {
+        auto const& command = model.commands[i];
+        if (command.branches.empty() || command.guard.eval(s) == 0)
+            return;
+        choice_t choice;
+        choice.reserve(command.branches.size());
+        for (auto const& branch : command.branches) {
+            transition_t tr{branch.prob.eval(s), s, branch.exact};
+            branch.update.apply(s, tr.next);
+            choice.push_back(std::move(tr));
+        }
+        choices.push_back(std::move(choice));
+    };
+
+    for (auto i : model.commands_at(s))
+        visit(i);
+    for (auto i : model.unlocated)
+        visit(i);
+
+    if (choices.empty())
+        choices.push_back(choice_t{transition_t{1.0, s, 0}});
+}
+
+explicit_mdp_t explore(successor_generator_t const& generator) {
+    explicit_mdp_t result;
+    result.variables = generator.variables();
+    result.exact_probs = generator.exact_probs();
+    result.choice_begin.push_back(0);
+    result.transition_begin.push_back(0);
+    bool exact = !result.exact_probs.empty();
+
+    std::unordered_map<state_t, size_t, state_hash_t> ids;
+    auto id_of = [&](state_t const& s) {
+        auto found = ids.find(s);
+        if (found != ids.end())
+            return found->second;
+        size_t id = result.states.size();
+        ids.emplace(s, id);
+        result.states.push_back(s);
+        return id;
+    };
+
+    id_of(generator.initial_state());
+    std::vector<choice_t> choices;
+    // states are numbered in BFS order, so the next unexpanded one is `i`
+    for (size_t i=0; i<result.states.size(); ++i) {
+        generator.successors(result.states[i], choices);
+        for (auto const& choice : choices) {
+            for (auto const& tr : choice) {
+                result.successors.push_back(id_of(tr.next));
+                result.probs.push_back(tr.prob);
+                if (exact)
+                    result.exact_of.push_back(tr.exact);
+            }
+            result.transition_begin.push_back(result.successors.size());
+        }
+        result.choice_begin.push_back(result.transition_begin.size() - 1);
+    }
+    return result;
+}
+
+explicit_mdp_t explore(mdp_t const& mdp) {
+    return explore(successor_generator_t{mdp});
+}
+
+partial_explorer_t::partial_explorer_t(successor_generator_t const& generator, compiled_expr_t stop) :
+    generator{generator}, stop{std::move(stop)}
+{
+    id_of(generator.initial_state(), 1.0);
+}
+
+size_t partial_explorer_t::id_of(state_t const& s, double p) {
+    auto found = ids.find(s);
+    size_t id;
+    if (found != ids.end()) {
+        id = found->second;
+        if (expanded[id] || is_stopped[id] || p <= priority[id])
+            return id;
+        priority[id] = p;
+    } else {
+        id = states.size();
+        ids.emplace(s, id);
+        states.push_back(s);
+        is_stopped.push_back(stop.eval(s) != 0);
+        expanded.push_back(false);
+        priority.push_back(p);
+        choices.emplace_back();
+        if (is_stopped[id])
+            return id;
+    }
+    // an entry with an outdated priority is skipped when popped
+    queue.emplace(p, id);
+    return id;
+}
+
+void partial_explorer_t::expand(size_t count) {
+    std::vector<choice_t> successors;
+    while (count > 0 && !queue.empty()) {
+        auto top = queue.top();
+        queue.pop();
+        auto id = top.second;
+        if (expanded[id] || top.first < priority[id])
+            continue;
+        expanded[id] = true;
+        --count;
+
+        generator.successors(states[id], successors);
+        std::vector<std::vector<edge_t>> result;
+        for (auto const& choice : successors) {
+            result.emplace_back();
+            for (auto const& tr : choice)
+                result.back().push_back(edge_t{tr.prob, tr.exact, id_of(tr.next, priority[id] * tr.prob)});
+        }
+        choices[id] = std::move(result);
+    }
+}
+
+explicit_mdp_t partial_explorer_t::snapshot(std::vector<bool>& frontier) const {
+    explicit_mdp_t result;
+    result.variables = generator.variables();
+    result.states = states;
+    result.exact_probs = generator.exact_probs();
+    bool exact = !result.exact_probs.empty();
+    result.choice_begin.push_back(0);
+    result.transition_begin.push_back(0);
+    frontier.assign(states.size(), false);
+    for (size_t s=0; s<states.size(); ++s) {
+        if (expanded[s]) {
+            for (auto const& choice : choices[s]) {
+                for (auto const& edge : choice) {
+                    result.probs.push_back(edge.prob);
+                    result.successors.push_back(edge.next);
+                    if (exact)
+                        result.exact_of.push_back(edge.exact);
+                }
+                result.transition_begin.push_back(result.successors.size());
+            }
+        } else {
+            frontier[s] = !is_stopped[s];
+            result.probs.push_back(1.0);
+            result.successors.push_back(s);
+            if (exact)
+                result.exact_of.push_back(0);
+            result.transition_begin.push_back(result.successors.size());
+        }
+        result.choice_begin.push_back(result.transition_begin.size() - 1);
+    }
+    return result;
+}
+
+}
@@ -1,3 +1,5 @@
+#include <stdexcept>
+
 #include "utility.hpp"
 #include "mdp_expr.hpp"
 
@@ -37,32 +39,48 @@ std::ostream& operator<<(std::ostream& os, binop_kind_t kind) {
     return os;
 }
 
+// an operand of `kind` that is itself an operation is parenthesized,
+// unless both are the same associative operation
+static std::ostream& print_operand(std::ostream& os, expr_t const& e, binop_kind_t kind) {
+    if (e.kind() != expr_kind_t::BinOp)
+        return os << e;
+    auto inner = cast<binop_expr_t>(e).binop_kind;
+    bool associative =
+        kind == binop_kind_t::And || kind == binop_kind_t::Or ||
+        kind == binop_kind_t::Add || kind == binop_kind_t::Mul;
+    if (inner == binop_kind_t::Eq || (inner == kind && associative))
+        return os << e;
+    return os << "(" << e << ")";
+}
+
 std::ostream& operator<<(std::ostream& os, expr_t const& e) {
     switch (e.kind()) {
     case expr_kind_t::Int:
-        os << cast<int_expr_t>(e).n; break;
+        if (cast<int_expr_t>(e).n < 0)
+            os << "(" << cast<int_expr_t>(e).n << ")";
+        else
+            os << cast<int_expr_t>(e).n;
+        break;
     case expr_kind_t::Real:
         os << cast<real_expr_t>(e).d; break;
     case expr_kind_t::Bool:
-        os << cast<bool_expr_t>(e).b; break;
+        os << (cast<bool_expr_t>(e).b ? "true" : "false"); break;
     case expr_kind_t::Var:
         os << cast<var_expr_t>(e).name; break;
     case expr_kind_t::Neg:
         os << "!(" << *cast<neg_expr_t>(e).inner << ")";
         break;
-    case expr_kind_t::BinOp:
-        if (cast<binop_expr_t>(e).binop_kind != binop_kind_t::Eq) {
-            os <<
-                *cast<binop_expr_t>(e).lhs <<
-                cast<binop_expr_t>(e).binop_kind <<
-                *cast<binop_expr_t>(e).rhs;
-        } else {
-            os << "(" <<
-                *cast<binop_expr_t>(e).lhs <<
-                cast<binop_expr_t>(e).binop_kind <<
-                *cast<binop_expr_t>(e).rhs << ")";
-        }
+    case expr_kind_t::BinOp: {
+        auto const& binop = cast<binop_expr_t>(e);
+        bool eq = binop.binop_kind == binop_kind_t::Eq;
+        if (eq)
+            os << "(";
+        print_operand(os, *binop.lhs, binop.binop_kind) << binop.binop_kind;
+        print_operand(os, *binop.rhs, binop.binop_kind);
+        if (eq)
+            os << ")";
         break;
+        }
     case expr_kind_t::If:
         os << "(" <<
             *cast<if_expr_t>(e).cond << "?" <<
@@ -183,4 +201,3 @@ bool operator==(expr_t const& lhs, expr_t const& rhs) {
 }
 
 }
-
@@ -0,0 +1,221 @@
+#include <map>
+#include <stdexcept>
+
+#include "checker.hpp"
+
+namespace checker {
+
+using mdp::explicit_mdp_t;
+
+rational_t to_rational(double x) {
+    return rational_t{x};
+}
+
+// solves A x = b for a nonsingular M-matrix A, which needs no pivoting
+static std::vector<rational_t> solve(
+        std::vector<std::map<size_t, rational_t>> rows,
+        std::vector<rational_t> rhs) {
+    size_t n = rows.size();
+    for (size_t i=0; i<n; ++i) {
+        auto pivot = rows[i].at(i);
+        for (size_t j=i+1; j<n; ++j) {
+            auto found = rows[j].find(i);
+            if (found == rows[j].end())
+                continue;
+            rational_t factor = found->second / pivot;
+            rows[j].erase(found);
+            for (auto const& entry : rows[i]) {
+                if (entry.first == i)
+                    continue;
+                auto& value = rows[j][entry.first];
+                value -= factor * entry.second;
+                if (value == 0)
+                    rows[j].erase(entry.first);
+            }
+            rhs[j] -= factor * rhs[i];
+        }
+    }
+    std::vector<rational_t> x(n);
+    for (size_t i=n; i-->0;) {
+        rational_t sum = rhs[i];
+        for (auto const& entry : rows[i]) {
+            if (entry.first > i)
+                sum -= entry.second * x[entry.first];
+        }
+        x[i] = sum / rows[i].at(i);
+    }
+    return x;
+}
+
+// without exact probabilities, the doubles are taken at their value
+static std::vector<rational_t> exact_probabilities(explicit_mdp_t const& model) {
+    std::vector<rational_t> probs;
+    probs.reserve(model.transition_count());
+    for (size_t t=0; t<model.transition_count(); ++t) {
+        if (model.is_exact())
+            probs.push_back(model.exact_probs[model.exact_of[t]]);
+        else
+            probs.push_back(to_rational(model.probs[t]));
+    }
+    return probs;
+}
+
+struct policy_solver_t {
+    explicit_mdp_t const& model;
+    qualitative_t const& qual;
+    std::vector<rational_t> probs;
+    std::vector<size_t> maybe;
+    std::vector<size_t> policy; // chosen choice of every state in `maybe`
+
+    policy_solver_t(explicit_mdp_t const& model, qualitative_t const& qual) :
+        model{model}, qual{qual}, probs{exact_probabilities(model)}
+    {
+        for (size_t s=0; s<model.state_count(); ++s) {
+            if (!qual.yes[s] && !qual.no[s]) {
+                maybe.push_back(s);
+                policy.push_back(model.choice_begin[s]);
+            }
+        }
+    }
+
+    rational_t choice_value(size_t c, std::vector<rational_t> const& x) const {
+        rational_t sum = 0;
+        for (auto t=model.transition_begin[c]; t<model.transition_begin[c+1]; ++t)
+            sum += probs[t] * x[model.successors[t]];
+        return sum;
+    }
+
+    // states that can not reach `yes` under the policy get 0, which keeps
+    // the system of the remaining ones nonsingular
+    std::vector<rational_t> evaluate() const {
+        size_t n = model.state_count();
+        std::vector<rational_t> x(n, 0);
+        std::vector<size_t> policy_of(n, model.choice_count());
+        for (size_t i=0; i<maybe.size(); ++i)
+            policy_of[maybe[i]] = policy[i];
+
+        std::vector<std::vector<size_t>> preds(n);
+        for (auto s : maybe) {
+            auto c = policy_of[s];
+            for (auto t=model.transition_begin[c]; t<model.transition_begin[c+1]; ++t)
+                preds[model.successors[t]].push_back(s);
+        }
+        std::vector<bool> reaches(n, false);
+        std::vector<size_t> queue;
+        for (size_t s=0; s<n; ++s) {
+            if (qual.yes[s]) {
+                x[s] = 1;
+                reaches[s] = true;
+                queue.push_back(s);
+            }
+        }
+        while (!queue.empty()) {
+            auto s = queue.back();
+            queue.pop_back();
+            for (auto p : preds[s]) {
+                if (!reaches[p]) {
+                    reaches[p] = true;
+                    queue.push_back(p);
+                }
+            }
+        }
+
+        std::vector<size_t> column(n, n), unknowns;
+        for (auto s : maybe) {
+            if (reaches[s]) {
+                column[s] = unknowns.size();
+                unknowns.push_back(s);
+            }
+        }
+        // x_s - sum_{t unknown} p x_t = sum_{t yes} p
+        std::vector<std::map<size_t, rational_t>> rows(unknowns.size());
+        std::vector<rational_t> rhs(unknowns.size(), 0);
+        for (size_t i=0; i<unknowns.size(); ++i) {
+            auto s = unknowns[i];
+            rows[i][i] = 1;
+            auto c = policy_of[s];
+            for (auto t=model.transition_begin[c]; t<model.transition_begin[c+1]; ++t) {
+                auto succ = model.successors[t];
+                if (qual.yes[succ])
+                    rhs[i] += probs[t];
+                else if (column[succ] != n)
+                    rows[i][column[succ]] -= probs[t];
+            }
+        }
+        auto solution = solve(std::move(rows), std::move(rhs));
+        for (size_t i=0; i<unknowns.size(); ++i)
+            x[unknowns[i]] = solution[i];
+        return x;
+    }
+
+    // switches to strictly better choices only, so a fixpoint is reached
+    bool improve(std::vector<rational_t> const& x, objective_t objective) {
+        bool changed = false;
+        for (size_t i=0; i<maybe.size(); ++i) {
+            auto s = maybe[i];
+            auto best = choice_value(policy[i], x);
+            for (auto c=model.choice_begin[s]; c<model.choice_begin[s+1]; ++c) {
+                auto value = choice_value(c, x);
+                if (objective == objective_t::Min ? value < best : value > best) {
+                    best = value;
+                    policy[i] = c;
+                    changed = true;
+                }
+            }
+        }
+        return changed;
+    }
+};
+
+// the exact counterpart of the sweep in `reach_bounds`
+static std::vector<rational_t> sweep(
+        explicit_mdp_t const& model,
+        std::vector<bool> const& target,
+        std::vector<size_t> const& order,
+        objective_t objective) {
+    auto probs = exact_probabilities(model);
+    std::vector<rational_t> x(model.state_count(), 0);
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        auto s = *it;
+        if (target[s]) {
+            x[s] = 1;
+            continue;
+        }
+        util::optional<rational_t> best;
+        for (auto c=model.choice_begin[s]; c<model.choice_begin[s+1]; ++c) {
+            rational_t sum = 0;
+            auto begin = model.transition_begin[c], end = model.transition_begin[c+1];
+            // the self-loop of a deadlock never reaches
+            if (end - begin != 1 || model.successors[begin] != s) {
+                for (auto t=begin; t<end; ++t)
+                    sum += probs[t] * x[model.successors[t]];
+            }
+            if (!best || (objective == objective_t::Min ? sum < *best : sum > *best))
+                best = sum;
+        }
+        x[s] = best ? *best : rational_t{0};
+    }
+    return x;
+}
+
+// a policy's value never exceeds Pmax and never goes below Pmin, and a
+// policy that can not be improved is a fixpoint of the Bellman operator.
+// Pmin has a unique fixpoint once Prob0E is fixed to 0; Pmax takes the
+// least one, so both end at the optimum.
+std::vector<rational_t> reach_exact(
+        explicit_mdp_t const& model,
+        std::vector<bool> const& target,
+        objective_t objective) {
+    auto order = topological_order(model);
+    if (order)
+        return sweep(model, target, *order, objective);
+    auto qual = precompute(model, target, objective);
+    policy_solver_t solver{model, qual};
+    while (true) {
+        auto x = solver.evaluate();
+        if (!solver.improve(x, objective))
+            return x;
+    }
+}
+
+}
@@ -0,0 +1,772 @@
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+
+#include "checker.hpp"
+
+namespace checker {
+
+using mdp::explicit_mdp_t;
+
+// the self-loop PRISM adds to a deadlock state
+static bool is_absorbing_choice(explicit_mdp_t const& model, size_t s, size_t c) {
+    auto begin = model.transition_begin[c];
+    auto end = model.transition_begin[c+1];
+    return end - begin == 1 && model.successors[begin] == s;
+}
+
+util::optional<std::vector<size_t>> topological_order(explicit_mdp_t const& model) {
+    size_t n = model.state_count();
+    std::vector<size_t> indegree(n, 0);
+    for (size_t s=0; s<n; ++s) {
+        for (auto c=model.choice_begin[s]; c<model.choice_begin[s+1]; ++c) {
+            if (is_absorbing_choice(model, s, c))
+                continue;
+            for (auto t=model.transition_begin[c]; t<model.transition_begin[c+1]; ++t) {
+                if (model.successors[t] == s)
+                    return util::nullopt;
+                ++indegree[model.successors[t]];
+            }
+        }
+    }
+
+    std::vector<size_t> order;
+    order.reserve(n);
+    for (size_t s=0; s<n; ++s) {
+        if (indegree[s] == 0)
+            order.push_back(s);
+    }
+    for (size_t i=0; i<order.size(); ++i) {
+        auto s = order[i];
+        for (auto c=model.choice_begin[s]; c<model.choice_begin[s+1]; ++c) {
+            if (is_absorbing_choice(model, s, c))
+                continue;
+            for (auto t=model.transition_begin[c]; t<model.transition_begin[c+1]; ++t) {
+                if (--indegree[model.successors[t]] == 0)
+                    order.push_back(model.successors[t]);
+            }
+        }
+    }
+    if (order.size() != n)
+        return util::nullopt;
+    return order;
+}
+
+// for each state, the choices that can move into it
+struct predecessors_t {
+    std::vector<size_t> choice_state;
+    std::vector<size_t> begin;
+    std::vector<size_t> choices;
+
+    explicit predecessors_t(explicit_mdp_t const& model) :
+        choice_state(model.choice_count()),
+        begin(model.state_count() + 1, 0)
+    {
+        for (size_t s=0; s<model.state_count(); ++s) {
+            for (auto c=model.choice_begin[s]; c<model.choice_begin[s+1]; ++c)
+                choice_state[c] = s;
+        }
+        for (auto t : model.successors)
+            ++begin[t+1];
+        for (size_t s=0; s<model.state_count(); ++s)
+            begin[s+1] += begin[s];
+        choices.resize(model.transition_count());
+        auto fill = begin;
+        for (size_t c=0; c<model.choice_count(); ++c) {
+            for (auto t=model.transition_begin[c]; t<model.transition_begin[c+1]; ++t)
+                choices[fill[model.successors[t]]++] = c;
+        }
+    }
+};
+
+// least fixpoint growing from `target`; `enter(c, s)` decides whether the
+// state `s` of a choice `c` that reaches a state of the set joins it
+template<typename F>
+static std::vector<bool> backward_fixpoint(
+        predecessors_t const& pred,
+        std::vector<bool> const& target,
+        F const& enter) {
+    std::vector<bool> result = target;
+    std::vector<size_t> worklist;
+    for (size_t s=0; s<target.size(); ++s) {
+        if (target[s])
+            worklist.push_back(s);
+    }
+    while (!worklist.empty()) {
+        auto t = worklist.back();
+        worklist.pop_back();
+        for (auto i=pred.begin[t]; i<pred.begin[t+1]; ++i) {
+            auto c = pred.choices[i];
+            auto s = pred.choice_state[c];
+            if (!result[s] && enter(c, s)) {
+                result[s] = true;
+                worklist.push_back(s);
+            }
+        }
+    }
+    return result;
+}
+
+static std::vector<bool> complement(std::vector<bool> v) {
+    v.flip();
+    return v;
+}
+
+std::vector<bool> prob0a(explicit_mdp_t const& model, std::vector<bool> const& target) {
+    predecessors_t pred{model};
+    // states that can reach the target at all
+    return complement(backward_fixpoint(pred, target, [](size_t, size_t) {
+        return true;
+    }));
+}
+
+std::vector<bool> prob0e(explicit_mdp_t const& model, std::vector<bool> const& target) {
+    predecessors_t pred{model};
+    // states all of whose choices can reach the target
+    std::vector<bool> hit(model.choice_count(), false);
+    std::vector<size_t> remaining(model.state_count());
+    for (size_t s=0; s<model.state_count(); ++s)
+        remaining[s] = model.choice_begin[s+1] - model.choice_begin[s];
+    return complement(backward_fixpoint(pred, target, [&](size_t c, size_t s) {
+        if (hit[c])
+            return false;
+        hit[c] = true;
+        return --remaining[s] == 0;
+    }));
+}
+
+// choices all of whose successors stay in `u`
+static std::vector<bool> closed_choices(explicit_mdp_t const& model, std::vector<bool> const& u) {
+    std::vector<bool> closed(model.choice_count(), true);
+    for (size_t c=0; c<model.choice_count(); ++c) {
+        for (auto t=model.transition_begin[c]; t<model.transition_begin[c+1]; ++t) {
+            if (!u[model.successors[t]]) {
+                closed[c] = false;
+                break;
+            }
+        }
+    }
+    return closed;
+}
+
+std::vector<bool> prob1e(explicit_mdp_t const& model, std::vector<bool> const& target) {
+    predecessors_t pred{model};
+    std::vector<bool> u(model.state_count(), true);
+    while (true) {
+        // some choice stays in `u` and moves closer to the target
+        auto closed = closed_choices(model, u);
+        auto r = backward_fixpoint(pred, target, [&](size_t c, size_t s) {
+            return u[s] && closed[c];
+        });
+        if (r == u)
+            return u;
+        u = std::move(r);
+    }
+}
+
+std::vector<bool> prob1a(explicit_mdp_t const& model, std::vector<bool> const& target) {
+    predecessors_t pred{model};
+    std::vector<bool> u(model.state_count(), true);
+    while (true) {
+        // every choice stays in `u` and moves closer to the target
+        auto closed = closed_choices(model, u);
+        std::vector<bool> all_closed(model.state_count(), true);
+        std::vector<size_t> remaining(model.state_count());
+        for (size_t s=0; s<model.state_count(); ++s) {
+            remaining[s] = model.choice_begin[s+1] - model.choice_begin[s];
+            for (auto c=model.choice_begin[s]; c<model.choice_begin[s+1]; ++c)
+                all_closed[s] = all_closed[s] && closed[c];
+        }
+        std::vector<bool> hit(model.choice_count(), false);
+        auto r = backward_fixpoint(pred, target, [&](size_t c, size_t s) {
+            if (hit[c])
+                return false;
+            hit[c] = true;
+            return --remaining[s] == 0 && all_closed[s] && u[s];
+        });
+        if (r == u)
+            return u;
+        u = std::move(r);
+    }
+}
+
+qualitative_t precompute(explicit_mdp_t const& model, std::vector<bool> const& target, objective_t objective) {
+    if (objective == objective_t::Min)
+        return qualitative_t{prob0e(model, target), prob1a(model, target)};
+    else
+        return qualitative_t{prob0a(model, target), prob1e(model, target)};
+}
+
+// one backward pass over an acyclic model: every successor is final
+// by the time a state is visited, so no iteration is needed. Each value
+// comes with a bound on its distance from the exact probability: the
+// rounding errors of its products and sums, recovered exactly by fma and
+// TwoSum, those of its successors, and the error of probabilities that
+// are no exact double (assumed within 2 eps of their exact value).
+static bounds_t reach_by_topological_sweep(
+        explicit_mdp_t const& model,
+        std::vector<bool> const& target,
+        std::vector<size_t> const& order,
+        objective_t objective) {
+    size_t n = model.state_count();
+    double const eps = std::numeric_limits<double>::epsilon();
+    double const tiny = std::numeric_limits<double>::denorm_min();
+    // the double of every exact probability that has one, NaN otherwise
+    std::vector<double> representable(model.exact_probs.size(), std::nan(""));
+    for (size_t i=0; i<model.exact_probs.size(); ++i) {
+        auto d = model.exact_probs[i].convert_to<double>();
+        if (rational_t{d} == model.exact_probs[i])
+            representable[i] = d;
+    }
+
+    std::vector<double> result(n, 0.0), error(n, 0.0);
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        auto s = *it;
+        if (target[s]) {
+            result[s] = 1.0;
+            continue;
+        }
+        util::optional<double> best;
+        double worst_error = 0.0;
+        for (auto c=model.choice_begin[s]; c<model.choice_begin[s+1]; ++c) {
+            double sum = 0.0; // staying in an absorbing state never reaches
+            if (!is_absorbing_choice(model, s, c)) {
+                double err = 0.0;
+                for (auto t=model.transition_begin[c]; t<model.transition_begin[c+1]; ++t) {
+                    double p = model.probs[t], x = result[model.successors[t]];
+                    double product = p * x;
+                    err += std::abs(std::fma(p, x, -product)) + p * error[model.successors[t]];
+                    if (product != 0.0 && product < std::numeric_limits<double>::min())
+                        err += tiny; // fma can not recover an underflow
+                    if (model.is_exact() && p != representable[model.exact_of[t]])
+                        err += 2 * eps * product;
+                    double next = sum + product;
+                    double z = next - sum;
+                    err += std::abs((sum - (next - z)) + (product - z));
+                    sum = next;
+                }
+                // `err` is itself a rounded sum of 3k nonnegative terms
+                auto k = model.transition_begin[c+1] - model.transition_begin[c];
+                worst_error = std::max(worst_error, err * (1 + 3 * k * eps));
+            }
+            if (!best)
+                best = sum;
+            else
+                best = objective == objective_t::Min ? std::min(*best, sum) : std::max(*best, sum);
+        }
+        result[s] = best ? *best : 0.0;
+        error[s] = worst_error;
+    }
+    bounds_t bounds{result, result};
+    for (size_t s=0; s<n; ++s) {
+        if (error[s] == 0.0)
+            continue;
+        bounds.lower[s] = std::max(0.0, std::nextafter(result[s] - error[s], 0.0));
+        bounds.upper[s] = std::min(1.0, std::nextafter(result[s] + error[s], 1.0));
+    }
+    return bounds;
+}
+
+// min/max over the choices of `s` of sparse dot products with `x`; the
+// successors and probabilities of a state are contiguous in the CSR arrays
+static inline double bellman_row(
+        explicit_mdp_t const& model,
+        size_t s,
+        objective_t objective,
+        double const* x) {
+    size_t const* transition_begin = model.transition_begin.data();
+    size_t const* successors = model.successors.data();
+    double const* probs = model.probs.data();
+    double best = objective == objective_t::Min ? 1.0 : 0.0;
+    for (auto c=model.choice_begin[s]; c<model.choice_begin[s+1]; ++c) {
+        double sum = 0.0;
+        for (auto t=transition_begin[c]; t<transition_begin[c+1]; ++t)
+            sum += probs[t] * x[successors[t]];
+        best = objective == objective_t::Min ? std::min(best, sum) : std::max(best, sum);
+    }
+    return best;
+}
+
+static unsigned thread_count(options_t const& options) {
+    if (options.threads != 0)
+        return options.threads;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// threads that stay alive across the sweeps of one solve; `run` splits
+// the rows into one contiguous block per thread, runs the first block on
+// the calling thread and waits for the others
+struct sweep_pool_t {
+    using task_t = std::function<void(size_t, size_t)>;
+
+    // no helper threads for models too small to gain from them
+    sweep_pool_t(options_t const& options, size_t rows) {
+        size_t threads = std::min<size_t>(thread_count(options), rows / min_rows_per_thread);
+        for (size_t i=1; i<threads; ++i)
+            workers.emplace_back([this, i] { work(i); });
+    }
+    sweep_pool_t(sweep_pool_t const&) = delete;
+    sweep_pool_t& operator=(sweep_pool_t const&) = delete;
+    ~sweep_pool_t() {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    void run(size_t rows, task_t const& f) {
+        if (workers.empty() || rows < 2 * min_rows_per_thread) {
+            f(0, rows);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            task = &f;
+            task_rows = rows;
+            pending = workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+        f(0, block_end(rows, 0));
+        std::unique_lock<std::mutex> lock{mutex};
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    static constexpr size_t min_rows_per_thread = 1 << 14;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    task_t const* task = nullptr;
+    size_t task_rows = 0;
+    size_t generation = 0;
+    size_t pending = 0;
+    bool stopping = false;
+
+    size_t block_end(size_t rows, size_t i) const {
+        size_t block = (rows + workers.size()) / (workers.size() + 1);
+        return std::min(rows, (i + 1) * block);
+    }
+    void work(size_t i) {
+        size_t seen = 0;
+        std::unique_lock<std::mutex> lock{mutex};
+        while (true) {
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+            auto const& f = *task;
+            size_t begin = block_end(task_rows, i - 1), end = block_end(task_rows, i);
+            lock.unlock();
+            if (begin < end)
+                f(begin, end);
+            lock.lock();
+            if (--pending == 0)
+                done.notify_one();
+        }
+    }
+};
+
+// Jacobi sweep of the Bellman operator over `states`, reading `x`.
+// Every row only reads `x`, so the result does not depend on how the
+// pool splits the rows.
+static void bellman(
+        explicit_mdp_t const& model,
+        std::vector<size_t> const& states,
+        objective_t objective,
+        std::vector<double> const& x,
+        std::vector<double>& next,
+        sweep_pool_t& pool) {
+    pool.run(states.size(), [&](size_t begin, size_t end) {
+        double const* in = x.data();
+        double* out = next.data();
+        for (size_t i=begin; i<end; ++i)
+            out[states[i]] = bellman_row(model, states[i], objective, in);
+    });
+}
+
+std::vector<std::vector<size_t>> strongly_connected_components(
+        explicit_mdp_t const& model,
+        std::vector<bool> const& states,
+        std::vector<bool> const& choices) {
+    // iterative Tarjan
+    size_t const none = (size_t)-1;
+    size_t n = model.state_count();
+    std::vector<size_t> index(n, none), lowlink(n, 0);
+    std::vector<bool> on_stack(n, false);
+    std::vector<size_t> stack;
+    std::vector<std::vector<size_t>> result;
+    size_t counter = 0;
+
+    // (state, next transition to look at) where transitions of all the
+    // state's followed choices are scanned in CSR order
+    struct frame_t {
+        size_t s, c, t;
+    };
+    std::vector<frame_t> call;
+
+    auto next_edge = [&](frame_t& f) -> util::optional<size_t> {
+        while (f.c < model.choice_begin[f.s+1]) {
+            if (choices[f.c] && f.t < model.transition_begin[f.c+1]) {
+                auto succ = model.successors[f.t++];
+                if (states[succ])
+                    return succ;
+                continue;
+            }
+            ++f.c;
+            if (f.c < model.choice_begin[f.s+1])
+                f.t = model.transition_begin[f.c];
+        }
+        return util::nullopt;
+    };
+    auto open = [&](size_t s) {
+        index[s] = lowlink[s] = counter++;
+        stack.push_back(s);
+        on_stack[s] = true;
+        auto c = model.choice_begin[s];
+        call.push_back(frame_t{s, c, c < model.choice_begin[s+1] ? model.transition_begin[c] : 0});
+    };
+
+    for (size_t root=0; root<n; ++root) {
+        if (!states[root] || index[root] != none)
+            continue;
+        open(root);
+        while (!call.empty()) {
+            auto& f = call.back();
+            auto succ = next_edge(f);
+            if (succ) {
+                if (index[*succ] == none)
+                    open(*succ);
+                else if (on_stack[*succ])
+                    lowlink[f.s] = std::min(lowlink[f.s], index[*succ]);
+                continue;
+            }
+            auto s = f.s;
+            call.pop_back();
+            if (!call.empty())
+                lowlink[call.back().s] = std::min(lowlink[call.back().s], lowlink[s]);
+            if (lowlink[s] != index[s])
+                continue;
+            std::vector<size_t> component;
+            size_t t;
+            do {
+                t = stack.back();
+                stack.pop_back();
+                on_stack[t] = false;
+                component.push_back(t);
+            } while (t != s);
+            result.push_back(std::move(component));
+        }
+    }
+    return result;
+}
+
+end_components_t maximal_end_components(explicit_mdp_t const& model, std::vector<bool> const& states) {
+    auto scope = states;
+    std::vector<bool> inside(model.choice_count(), false);
+    for (size_t s=0; s<model.state_count(); ++s) {
+        if (!scope[s])
+            continue;
+        for (auto c=model.choice_begin[s]; c<model.choice_begin[s+1]; ++c)
+            inside[c] = true;
+    }
+
+    std::vector<size_t> component_of(model.state_count());
+    while (true) {
+        auto sccs = strongly_connected_components(model, scope, inside);
+        for (size_t i=0; i<sccs.size(); ++i) {
+            for (auto s : sccs[i])
+                component_of[s] = i;
+        }
+        // drop choices that can leave their SCC, then states without choices
+        bool changed = false;
+        for (size_t s=0; s<model.state_count(); ++s) {
+            if (!scope[s])
+                continue;
+            bool has_choice = false;
+            for (auto c=model.choice_begin[s]; c<model.choice_begin[s+1]; ++c) {
+                if (!inside[c])
+                    continue;
+                for (auto t=model.transition_begin[c]; t<model.transition_begin[c+1]; ++t) {
+                    auto succ = model.successors[t];
+                    if (!scope[succ] || component_of[succ] != component_of[s]) {
+                        inside[c] = false;
+                        changed = true;
+                        break;
+                    }
+                }
+                has_choice = has_choice || inside[c];
+            }
+            if (!has_choice) {
+                scope[s] = false;
+                changed = true;
+            }
+        }
+        if (changed)
+            continue;
+
+        end_components_t result;
+        result.components = std::move(sccs);
+        result.inside = std::move(inside);
+        return result;
+    }
+}
+
+// the upper bound of a maximizing end component can not exceed its best exit
+static void deflate(
+        explicit_mdp_t const& model,
+        std::vector<size_t> const& component,
+        std::vector<bool> const& inside,
+        std::vector<double>& upper) {
+    double best_exit = 0.0;
+    for (auto s : component) {
+        for (auto c=model.choice_begin[s]; c<model.choice_begin[s+1]; ++c) {
+            if (inside[c])
+                continue;
+            double sum = 0.0;
+            for (auto t=model.transition_begin[c]; t<model.transition_begin[c+1]; ++t)
+                sum += model.probs[t] * upper[model.successors[t]];
+            best_exit = std::max(best_exit, sum);
+        }
+    }
+    for (auto s : component)
+        upper[s] = std::min(upper[s], best_exit);
+}
+
+// a single state without a self-loop only reads already solved states
+static bool is_trivial_component(explicit_mdp_t const& model, std::vector<size_t> const& scc) {
+    if (scc.size() != 1)
+        return false;
+    auto s = scc[0];
+    for (auto t=model.transition_begin[model.choice_begin[s]]; t<model.transition_begin[model.choice_begin[s+1]]; ++t) {
+        if (model.successors[t] == s)
+            return false;
+    }
+    return true;
+}
+
+// in-place sweep over `states`, relaxed by `omega`; returns the
+// largest change
+static double gauss_seidel(
+        explicit_mdp_t const& model,
+        std::vector<size_t> const& states,
+        objective_t objective,
+        double omega,
+        std::vector<double>& x) {
+    double diff = 0.0;
+    for (auto s : states) {
+        double value = bellman_row(model, s, objective, x.data());
+        if (omega != 1.0)
+            value = std::min(1.0, std::max(0.0, x[s] + omega * (value - x[s])));
+        diff = std::max(diff, std::abs(value - x[s]));
+        x[s] = value;
+    }
+    return diff;
+}
+
+// the states left undecided by `precompute`, split into SCCs sinks first
+struct decomposition_t {
+    std::vector<bool> is_maybe;
+    std::vector<std::vector<size_t>> sccs;
+};
+
+static decomposition_t decompose(explicit_mdp_t const& model, qualitative_t const& qual) {
+    decomposition_t result;
+    result.is_maybe.resize(model.state_count());
+    for (size_t s=0; s<model.state_count(); ++s)
+        result.is_maybe[s] = !qual.yes[s] && !qual.no[s];
+    std::vector<bool> all_choices(model.choice_count(), true);
+    result.sccs = strongly_connected_components(model, result.is_maybe, all_choices);
+    // states are numbered in BFS order from the initial state, so visiting
+    // them backwards lets Gauss-Seidel push values up a chain in one sweep
+    for (auto& scc : result.sccs)
+        std::sort(scc.rbegin(), scc.rend());
+    return result;
+}
+
+// stops early once a threshold is decided by the bounds of the initial state
+static bool decides(util::optional<threshold_t> const& threshold, double lower, double upper) {
+    return threshold && threshold->decide(to_rational(lower), to_rational(upper)) != verdict_t::Unknown;
+}
+
+// topological value iteration: every SCC is iterated on its own once all
+// the SCCs it can reach are solved, so the acyclic parts take one sweep
+static bounds_t reach_by_value_iteration(
+        explicit_mdp_t const& model,
+        qualitative_t const& qual,
+        objective_t objective,
+        options_t const& options,
+        util::optional<threshold_t> const& threshold) {
+    size_t n = model.state_count();
+    std::vector<double> x(n, 0.0);
+    for (size_t s=0; s<n; ++s) {
+        if (qual.yes[s])
+            x[s] = 1.0;
+    }
+    auto next = x;
+    // Gauss-Seidel and SOR sweeps are sequential
+    sweep_pool_t pool{options, options.method == method_t::Jacobi ? n : 0};
+    // iterating from 0 approaches from below, unless over-relaxed
+    bool from_below = options.method != method_t::SOR || options.omega <= 1.0;
+
+    for (auto const& scc : decompose(model, qual).sccs) {
+        if (is_trivial_component(model, scc)) {
+            bellman(model, scc, objective, x, x, pool);
+            next[scc[0]] = x[scc[0]];
+            continue;
+        }
+        bool initial = std::find(scc.begin(), scc.end(), 0) != scc.end();
+        size_t iter = 0;
+        for (; iter<options.max_iterations; ++iter) {
+            double diff = 0.0;
+            if (options.method == method_t::Jacobi) {
+                bellman(model, scc, objective, x, next, pool);
+                for (auto s : scc)
+                    diff = std::max(diff, std::abs(next[s] - x[s]));
+                std::swap(x, next);
+            } else {
+                double omega = options.method == method_t::SOR ? options.omega : 1.0;
+                diff = gauss_seidel(model, scc, objective, omega, x);
+            }
+            if (diff < options.precision)
+                break;
+            if (initial && from_below && decides(threshold, x[0], 1.0)) {
+                bounds_t bounds{x, x};
+                for (size_t s=0; s<n; ++s) {
+                    if (!qual.yes[s] && !qual.no[s])
+                        bounds.upper[s] = 1.0;
+                }
+                return bounds;
+            }
+        }
+        if (iter == options.max_iterations) {
+            throw std::runtime_error{format(
+                    "value iteration did not converge in {} iterations", options.max_iterations)};
+        }
+        for (auto s : scc)
+            next[s] = x[s];
+    }
+    return bounds_t{x, x};
+}
+
+// interval iteration (Haddad and Monmege; Baier et al.): the lower bound
+// starts from 0 and the upper bound from 1 on the undecided states.
+// Pmin converges once Prob0E states are fixed to 0, Pmax additionally
+// needs the upper bound of end components deflated to their best exit.
+// SCCs are solved one by one as in `reach_by_value_iteration`.
+static bounds_t reach_by_interval_iteration(
+        explicit_mdp_t const& model,
+        qualitative_t const& qual,
+        objective_t objective,
+        options_t const& options,
+        util::optional<threshold_t> const& threshold) {
+    size_t n = model.state_count();
+    bounds_t bounds{std::vector<double>(n, 0.0), std::vector<double>(n, 0.0)};
+    for (size_t s=0; s<n; ++s) {
+        if (qual.yes[s])
+            bounds.lower[s] = 1.0;
+        if (!qual.no[s])
+            bounds.upper[s] = 1.0;
+    }
+    auto decomposition = decompose(model, qual);
+    auto const& sccs = decomposition.sccs;
+    sweep_pool_t pool{options, options.method == method_t::Jacobi ? n : 0};
+
+    // every end component lies within one SCC
+    end_components_t mecs;
+    std::vector<std::vector<size_t>> mecs_of_scc(sccs.size());
+    if (objective == objective_t::Max) {
+        mecs = maximal_end_components(model, decomposition.is_maybe);
+        std::vector<size_t> scc_of(n);
+        for (size_t i=0; i<sccs.size(); ++i) {
+            for (auto s : sccs[i])
+                scc_of[s] = i;
+        }
+        for (size_t i=0; i<mecs.components.size(); ++i)
+            mecs_of_scc[scc_of[mecs.components[i][0]]].push_back(i);
+    }
+
+    auto next_lower = bounds.lower;
+    auto next_upper = bounds.upper;
+    for (size_t i=0; i<sccs.size(); ++i) {
+        auto const& scc = sccs[i];
+        if (is_trivial_component(model, scc)) {
+            bellman(model, scc, objective, bounds.lower, bounds.lower, pool);
+            bellman(model, scc, objective, bounds.upper, bounds.upper, pool);
+            next_lower[scc[0]] = bounds.lower[scc[0]];
+            next_upper[scc[0]] = bounds.upper[scc[0]];
+            continue;
+        }
+        // later SCCs can not influence the initial state
+        bool initial = std::find(scc.begin(), scc.end(), 0) != scc.end();
+        size_t iter = 0;
+        for (; iter<options.max_iterations; ++iter) {
+            if (options.method == method_t::Jacobi) {
+                bellman(model, scc, objective, bounds.lower, next_lower, pool);
+                bellman(model, scc, objective, bounds.upper, next_upper, pool);
+                std::swap(bounds.lower, next_lower);
+                std::swap(bounds.upper, next_upper);
+            } else {
+                gauss_seidel(model, scc, objective, 1.0, bounds.lower);
+                gauss_seidel(model, scc, objective, 1.0, bounds.upper);
+            }
+            for (auto m : mecs_of_scc[i])
+                deflate(model, mecs.components[m], mecs.inside, bounds.upper);
+
+            double width = 0.0;
+            for (auto s : scc)
+                width = std::max(width, bounds.upper[s] - bounds.lower[s]);
+            if (width < options.precision)
+                break;
+            if (initial && decides(threshold, bounds.lower[0], bounds.upper[0]))
+                return bounds;
+        }
+        if (iter == options.max_iterations) {
+            throw std::runtime_error{format(
+                    "interval iteration did not converge in {} iterations", options.max_iterations)};
+        }
+        for (auto s : scc) {
+            next_lower[s] = bounds.lower[s];
+            next_upper[s] = bounds.upper[s];
+        }
+    }
+    return bounds;
+}
+
+bounds_t reach_bounds(
+        explicit_mdp_t const& model,
+        std::vector<bool> const& target,
+        objective_t objective,
+        options_t const& options,
+        util::optional<threshold_t> const& threshold) {
+    auto order = topological_order(model);
+    if (order)
+        return reach_by_topological_sweep(model, target, *order, objective);
+    auto qual = precompute(model, target, objective);
+    if (options.iteration == iteration_t::Interval) {
+        // over-relaxed values may leave the bounds
+        if (options.method == method_t::SOR)
+            throw std::runtime_error{"SOR is only supported by value iteration"};
+        return reach_by_interval_iteration(model, qual, objective, options, threshold);
+    }
+    return reach_by_value_iteration(model, qual, objective, options, threshold);
+}
+
+std::vector<double> reach_probability(
+        explicit_mdp_t const& model,
+        std::vector<bool> const& target,
+        objective_t objective,
+        options_t const& options) {
+    return reach_bounds(model, target, objective, options).lower;
+}
+
+}
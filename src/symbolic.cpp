@@ -0,0 +1,534 @@
+#include <cmath>
+#include <stdexcept>
+#include <limits>
+#include <algorithm>
+
+#include "symbolic.hpp"
+
+namespace checker {
+
+using bdd::op_t;
+using bdd::mtbdd_t;
+
+static op_t to_op(mdp::opcode_t op) {
+    using mdp::opcode_t;
+    switch (op) {
+    case opcode_t::Not: return op_t::Not;
+    case opcode_t::Mul: return op_t::Mul;
+    case opcode_t::Div: return op_t::Div;
+    case opcode_t::Add: return op_t::Add;
+    case opcode_t::Sub: return op_t::Sub;
+    case opcode_t::Lt: return op_t::Lt;
+    case opcode_t::Leq: return op_t::Leq;
+    case opcode_t::Geq: return op_t::Geq;
+    case opcode_t::Gt: return op_t::Gt;
+    case opcode_t::Eq: return op_t::Eq;
+    case opcode_t::Neq: return op_t::Neq;
+    case opcode_t::And: return op_t::And;
+    case opcode_t::Or: return op_t::Or;
+    case opcode_t::Iff: return op_t::Iff;
+    case opcode_t::Impl: return op_t::Impl;
+    case opcode_t::Min: return op_t::Min;
+    case opcode_t::Max: return op_t::Max;
+    case opcode_t::Floor: return op_t::Floor;
+    case opcode_t::Ceil: return op_t::Ceil;
+    case opcode_t::Pow: return op_t::Pow;
+    case opcode_t::Mod: return op_t::Mod;
+    case opcode_t::Log: return op_t::Log;
+    default:
+        throw std::logic_error{"no MTBDD operator"};
+    }
+}
+
+symbolic_mdp_t::symbolic_mdp_t(mdp::mdp_t const& mdp) :
+    compiled{mdp}
+{
+    zero = manager.constant(0.0);
+    one = manager.constant(1.0);
+
+    // bits follow `variable_order`, which keeps related variables close
+    vars.resize(mdp.variables.size());
+    std::vector<std::uint32_t> current_levels, next_levels;
+    for (auto slot : mdp::variable_order(compiled)) {
+        auto const& var = mdp.variables[slot];
+        auto bound = var.is_int() ? var.as_int().bound : bound_t{0, 1};
+        std::uint32_t bits = 0;
+        while ((1LL << bits) < (long long)bound.max - bound.min + 1)
+            ++bits;
+        vars[slot] = encoded_var_t{bound.min, bound.max, bit_count, bits};
+        for (std::uint32_t b=0; b<bits; ++b) {
+            current_levels.push_back(2 * (bit_count + b));
+            next_levels.push_back(2 * (bit_count + b) + 1);
+        }
+        bit_count += bits;
+    }
+    current_cube = manager.cube(current_levels);
+    next_cube = manager.cube(next_levels);
+
+    valid = one;
+    initial = one;
+    initial_assignment.assign(2 * bit_count, false);
+    for (size_t slot=0; slot<vars.size(); ++slot) {
+        valid = manager.apply(op_t::Mul, valid,
+                manager.apply(op_t::Not, less(constant_bits(vars[slot].max), bits_of(slot))));
+        auto offset = compiled.initial[slot] - vars[slot].min;
+        for (std::uint32_t b=0; b<vars[slot].bits; ++b) {
+            bool set = (offset >> (vars[slot].bits - 1 - b)) & 1;
+            auto level = 2 * (vars[slot].first_bit + b);
+            initial_assignment[level] = set;
+            auto bit = manager.variable(level);
+            initial = manager.apply(op_t::Mul, initial, set ? bit : manager.apply(op_t::Not, bit));
+        }
+    }
+
+    enabled = zero;
+    relation = zero;
+    for (auto const& command : compiled.commands) {
+        auto guard = manager.apply(op_t::Mul, valid,
+                manager.apply(op_t::Neq, encode(command.guard), zero));
+        auto transitions = zero;
+        for (auto const& branch : command.branches) {
+            transitions = manager.apply(op_t::Add, transitions,
+                    manager.apply(op_t::Mul, encode(branch.prob), encode(branch.update)));
+        }
+        transitions = manager.apply(op_t::Mul, guard, transitions);
+        if (transitions == zero)
+            continue;
+        enabled = manager.apply(op_t::Or, enabled, guard);
+        relation = manager.apply(op_t::Or, relation, manager.apply(op_t::Gt, transitions, zero));
+        commands.push_back(encoded_command_t{guard, transitions});
+    }
+}
+
+mtbdd_t symbolic_mdp_t::value_of(size_t slot, bool next) {
+    auto const& var = vars[slot];
+    auto result = manager.constant(var.min);
+    for (std::uint32_t b=0; b<var.bits; ++b) {
+        auto level = 2 * (var.first_bit + b) + (next ? 1 : 0);
+        auto weight = manager.constant(std::ldexp(1.0, var.bits - 1 - b));
+        result = manager.apply(op_t::Add, result, manager.apply(op_t::Mul, manager.variable(level), weight));
+    }
+    return result;
+}
+
+// runs the bytecode over MTBDDs instead of numbers; conditions go bit by
+// bit, since an MTBDD of an integer has a terminal for each value
+mtbdd_t symbolic_mdp_t::encode(mdp::compiled_expr_t const& e) {
+    using mdp::opcode_t;
+    auto bits = encode_bits(e);
+    if (bits && bits->min >= 0 && bits->max <= 1)
+        return bits->bits[0];
+    std::vector<mtbdd_t> stack;
+    for (auto const& instr : e.code) {
+        switch (instr.op) {
+        case opcode_t::Const:
+            stack.push_back(manager.constant(instr.value));
+            break;
+        case opcode_t::Load:
+            stack.push_back(value_of(instr.arg, false));
+            break;
+        case opcode_t::Not:
+        case opcode_t::Floor:
+        case opcode_t::Ceil:
+            stack.back() = manager.apply(to_op(instr.op), stack.back());
+            break;
+        case opcode_t::Select: {
+            auto f = stack[stack.size() - 1];
+            auto t = stack[stack.size() - 2];
+            auto cond = manager.apply(op_t::Neq, stack[stack.size() - 3], zero);
+            stack.resize(stack.size() - 3);
+            stack.push_back(manager.ite(cond, t, f));
+            break;
+            }
+        case opcode_t::Min:
+        case opcode_t::Max: {
+            auto first = stack.size() - instr.arg;
+            for (size_t i=first+1; i<stack.size(); ++i)
+                stack[first] = manager.apply(to_op(instr.op), stack[first], stack[i]);
+            stack.resize(first + 1);
+            break;
+            }
+        default: {
+            auto rhs = stack.back();
+            stack.pop_back();
+            stack.back() = manager.apply(to_op(instr.op), stack.back(), rhs);
+            break;
+            }
+        }
+    }
+    return stack.back();
+}
+
+// 0/1 over (current, next): assigned variables take their new value and
+// the others keep theirs
+mtbdd_t symbolic_mdp_t::encode(mdp::compiled_update_t const& update) {
+    std::vector<bool> assigned(vars.size(), false);
+    auto result = one;
+    for (auto const& assign : update.assignments) {
+        assigned[assign.slot] = true;
+        result = manager.apply(op_t::Mul, result, assignment(assign.slot, assign.value));
+    }
+    for (size_t slot=0; slot<vars.size(); ++slot) {
+        if (assigned[slot])
+            continue;
+        for (std::uint32_t b=0; b<vars[slot].bits; ++b) {
+            auto level = 2 * (vars[slot].first_bit + b);
+            result = manager.apply(op_t::Mul, result,
+                    manager.apply(op_t::Iff, manager.variable(level), manager.variable(level + 1)));
+        }
+    }
+    return result;
+}
+
+// 0/1 over (current, next): the next value of `slot` is `value`. Each
+// next bit is tied to the matching bit of `value - min`, where comparing
+// the MTBDDs of both values would visit every pair of them.
+mtbdd_t symbolic_mdp_t::assignment(size_t slot, mdp::compiled_expr_t const& value) {
+    auto const& var = vars[slot];
+    auto bits = encode_bits(value);
+    if (!bits)
+        return manager.apply(op_t::Eq, value_of(slot, true), encode(value));
+    auto offset = var.min == 0 ? *bits : add(*bits, constant_bits(var.min), true);
+    // values that the next bits can not hold have no successor
+    auto result = one;
+    if (offset.min < 0)
+        result = manager.apply(op_t::Not, less(offset, constant_bits(0)));
+    auto largest = (1LL << var.bits) - 1;
+    if (offset.max > largest)
+        result = manager.apply(op_t::Mul, result,
+                manager.apply(op_t::Not, less(constant_bits(largest), offset)));
+    for (std::uint32_t k=0; k<var.bits; ++k) {
+        auto level = 2 * (var.first_bit + var.bits - 1 - k) + 1;
+        result = manager.apply(op_t::Mul, result,
+                manager.apply(op_t::Iff, manager.variable(level), bit(offset, k)));
+    }
+    return result;
+}
+
+// width of the two's complement of every value in [min, max]
+static std::size_t width_of(long long min, long long max) {
+    std::size_t width = 1;
+    while (min < -(1LL << (width - 1)) || max >= (1LL << (width - 1)))
+        ++width;
+    return width;
+}
+
+// bit `i`, extending the sign beyond the stored bits
+mtbdd_t const& symbolic_mdp_t::bit(bits_t const& x, std::size_t i) {
+    return i < x.bits.size() ? x.bits[i] : x.bits.back();
+}
+
+// integers beyond this are left to MTBDDs, so products stay in a long long
+static constexpr long long bits_limit = 1LL << 30;
+
+util::optional<symbolic_mdp_t::bits_t> symbolic_mdp_t::encode_bits(mdp::compiled_expr_t const& e) {
+    using mdp::opcode_t;
+    std::vector<bits_t> stack;
+    for (auto const& instr : e.code) {
+        switch (instr.op) {
+        case opcode_t::Const:
+            if (instr.value != std::floor(instr.value) || std::abs(instr.value) > bits_limit)
+                return util::nullopt;
+            stack.push_back(constant_bits((long long)instr.value));
+            break;
+        case opcode_t::Load:
+            stack.push_back(bits_of(instr.arg));
+            break;
+        case opcode_t::Not:
+            stack.back() = boolean(manager.apply(op_t::Not, truth(stack.back())));
+            break;
+        case opcode_t::Floor:
+        case opcode_t::Ceil:
+            break;
+        case opcode_t::Select: {
+            auto f = stack[stack.size() - 1];
+            auto t = stack[stack.size() - 2];
+            auto cond = truth(stack[stack.size() - 3]);
+            stack.resize(stack.size() - 3);
+            stack.push_back(select(cond, t, f));
+            break;
+            }
+        case opcode_t::Min:
+        case opcode_t::Max: {
+            auto first = stack.size() - instr.arg;
+            for (size_t i=first+1; i<stack.size(); ++i) {
+                auto& x = stack[first];
+                auto const& y = stack[i];
+                bool is_min = instr.op == opcode_t::Min;
+                auto r = select(is_min ? less(y, x) : less(x, y), y, x);
+                r.min = is_min ? std::min(x.min, y.min) : std::max(x.min, y.min);
+                r.max = is_min ? std::min(x.max, y.max) : std::max(x.max, y.max);
+                x = std::move(r);
+            }
+            stack.resize(first + 1);
+            break;
+            }
+        case opcode_t::Add:
+        case opcode_t::Sub:
+        case opcode_t::Mul:
+        case opcode_t::Lt:
+        case opcode_t::Leq:
+        case opcode_t::Geq:
+        case opcode_t::Gt:
+        case opcode_t::Eq:
+        case opcode_t::Neq:
+        case opcode_t::And:
+        case opcode_t::Or:
+        case opcode_t::Iff:
+        case opcode_t::Impl: {
+            auto b = std::move(stack.back());
+            stack.pop_back();
+            auto a = std::move(stack.back());
+            stack.pop_back();
+            switch (instr.op) {
+            case opcode_t::Add: stack.push_back(add(a, b, false)); break;
+            case opcode_t::Sub: stack.push_back(add(a, b, true)); break;
+            case opcode_t::Mul: stack.push_back(mul(a, b)); break;
+            case opcode_t::Lt: stack.push_back(boolean(less(a, b))); break;
+            case opcode_t::Gt: stack.push_back(boolean(less(b, a))); break;
+            case opcode_t::Leq: stack.push_back(boolean(manager.apply(op_t::Not, less(b, a)))); break;
+            case opcode_t::Geq: stack.push_back(boolean(manager.apply(op_t::Not, less(a, b)))); break;
+            case opcode_t::Eq: stack.push_back(boolean(equal(a, b))); break;
+            case opcode_t::Neq: stack.push_back(boolean(manager.apply(op_t::Not, equal(a, b)))); break;
+            default:
+                stack.push_back(boolean(manager.apply(to_op(instr.op), truth(a), truth(b))));
+                break;
+            }
+            break;
+            }
+        default:
+            return util::nullopt;
+        }
+        if (stack.back().min < -bits_limit || stack.back().max > bits_limit)
+            return util::nullopt;
+    }
+    return stack.back();
+}
+
+// every encoding of the bits, including those above the maximum
+symbolic_mdp_t::bits_t symbolic_mdp_t::bits_of(size_t slot) {
+    auto const& var = vars[slot];
+    bits_t offset{{}, 0, (1LL << var.bits) - 1};
+    for (std::uint32_t k=0; k<var.bits; ++k)
+        offset.bits.push_back(manager.variable(2 * (var.first_bit + var.bits - 1 - k)));
+    offset.bits.push_back(zero);
+    return var.min == 0 ? offset : add(offset, constant_bits(var.min), false);
+}
+
+symbolic_mdp_t::bits_t symbolic_mdp_t::constant_bits(long long c) {
+    bits_t result{{}, c, c};
+    for (std::size_t i=0; i<width_of(c, c); ++i)
+        result.bits.push_back((c >> i) & 1 ? one : zero);
+    return result;
+}
+
+symbolic_mdp_t::bits_t symbolic_mdp_t::boolean(mtbdd_t const& b) {
+    return bits_t{{b, zero}, manager.is_constant(b) ? (long long)manager.value(b) : 0,
+        manager.is_constant(b) ? (long long)manager.value(b) : 1};
+}
+
+// ripple carry over enough bits for the sum, with a - b as a + ~b + 1
+symbolic_mdp_t::bits_t symbolic_mdp_t::add(bits_t const& a, bits_t const& b, bool subtract) {
+    bits_t result{{}, subtract ? a.min - b.max : a.min + b.min, subtract ? a.max - b.min : a.max + b.max};
+    auto width = width_of(result.min, result.max);
+    auto carry = subtract ? one : zero;
+    for (std::size_t i=0; i<width; ++i) {
+        auto x = bit(a, i);
+        auto y = bit(b, i);
+        if (subtract)
+            y = manager.apply(op_t::Not, y);
+        auto half = manager.apply(op_t::Neq, x, y);
+        result.bits.push_back(manager.apply(op_t::Neq, half, carry));
+        carry = manager.ite(half, carry, x);
+    }
+    return result;
+}
+
+// shift and add modulo 2^width, which is exact once the product fits
+symbolic_mdp_t::bits_t symbolic_mdp_t::mul(bits_t const& a, bits_t const& b) {
+    long long products[] = {a.min * b.min, a.min * b.max, a.max * b.min, a.max * b.max};
+    bits_t result{{}, *std::min_element(products, products + 4), *std::max_element(products, products + 4)};
+    auto width = width_of(result.min, result.max);
+    result.bits.assign(width, zero);
+    for (std::size_t i=0; i<width; ++i) {
+        auto multiplier = bit(b, i);
+        if (multiplier == zero)
+            continue;
+        auto carry = zero;
+        for (std::size_t j=i; j<width; ++j) {
+            auto x = result.bits[j];
+            auto y = manager.apply(op_t::Mul, multiplier, bit(a, j - i));
+            auto half = manager.apply(op_t::Neq, x, y);
+            result.bits[j] = manager.apply(op_t::Neq, half, carry);
+            carry = manager.ite(half, carry, x);
+        }
+    }
+    return result;
+}
+
+symbolic_mdp_t::bits_t symbolic_mdp_t::select(mtbdd_t const& cond, bits_t const& t, bits_t const& f) {
+    bits_t result{{}, std::min(t.min, f.min), std::max(t.max, f.max)};
+    auto width = std::max(t.bits.size(), f.bits.size());
+    for (std::size_t i=0; i<width; ++i) {
+        result.bits.push_back(manager.ite(cond,
+                bit(t, i), bit(f, i)));
+    }
+    return result;
+}
+
+// the sign of a - b, unless the ranges decide it
+mtbdd_t symbolic_mdp_t::less(bits_t const& a, bits_t const& b) {
+    if (a.max < b.min)
+        return one;
+    if (a.min >= b.max)
+        return zero;
+    return add(a, b, true).bits.back();
+}
+
+mtbdd_t symbolic_mdp_t::equal(bits_t const& a, bits_t const& b) {
+    if (a.max < b.min || b.max < a.min)
+        return zero;
+    auto result = one;
+    auto width = std::max(a.bits.size(), b.bits.size());
+    for (std::size_t i=0; i<width; ++i) {
+        result = manager.apply(op_t::Mul, result, manager.apply(op_t::Iff, bit(a, i), bit(b, i)));
+    }
+    return result;
+}
+
+// 0/1 where the value is not zero
+mtbdd_t symbolic_mdp_t::truth(bits_t const& a) {
+    if (a.min > 0 || a.max < 0)
+        return one;
+    auto result = zero;
+    for (auto const& bit : a.bits)
+        result = manager.ite(bit, one, result);
+    return result;
+}
+
+mtbdd_t symbolic_mdp_t::encode(mdp::expr_t const& e) {
+    return manager.apply(op_t::Mul, valid, encode(compiled.compile(e)));
+}
+
+// least fixpoint of the image of the transition relation
+mtbdd_t const& symbolic_mdp_t::reachable_set() {
+    if (reachable)
+        return *reachable;
+    auto states = initial;
+    while (true) {
+        auto image = manager.abstract(op_t::Max, manager.apply(op_t::Mul, states, relation), current_cube);
+        auto next = manager.apply(op_t::Or, states, manager.shift(image, -1));
+        if (next == states)
+            break;
+        states = next;
+    }
+    reachable = states;
+    return *reachable;
+}
+
+double symbolic_mdp_t::reachable_states() {
+    return manager.value(manager.abstract(op_t::Add, reachable_set(), current_cube));
+}
+
+// 0/1 over the current state: Prob0A for Max (the target is unreachable)
+// and Prob0E for Min (some choices avoid the target forever), where a
+// deadlock keeps its state like a self-loop
+mtbdd_t symbolic_mdp_t::prob0(mtbdd_t const& target, objective_t objective) {
+    auto const& states = reachable_set();
+    if (objective == objective_t::Max) {
+        auto reaching = target;
+        while (true) {
+            auto pre = manager.abstract(op_t::Max,
+                    manager.apply(op_t::Mul, relation, manager.shift(reaching, 1)), next_cube);
+            auto next = manager.apply(op_t::Or, reaching, manager.apply(op_t::Mul, states, pre));
+            if (next == reaching)
+                break;
+            reaching = next;
+        }
+        return manager.apply(op_t::Mul, states, manager.apply(op_t::Not, reaching));
+    }
+    auto avoiding = manager.apply(op_t::Mul, states, manager.apply(op_t::Not, target));
+    while (true) {
+        auto leaving = manager.apply(op_t::Not, manager.shift(avoiding, 1));
+        auto staying = manager.apply(op_t::Not, enabled);
+        for (auto const& command : commands) {
+            auto escapes = manager.abstract(op_t::Max,
+                    manager.apply(op_t::Mul, manager.apply(op_t::Gt, command.transitions, zero), leaving),
+                    next_cube);
+            staying = manager.apply(op_t::Or, staying,
+                    manager.apply(op_t::Mul, command.guard, manager.apply(op_t::Not, escapes)));
+        }
+        auto next = manager.apply(op_t::Mul, avoiding, staying);
+        if (next == avoiding)
+            break;
+        avoiding = next;
+    }
+    return avoiding;
+}
+
+// interval iteration: the lower bound starts from the target and the
+// upper bound from 1 outside `prob0`. The upper bound is sound from the
+// start, but without deflating end components it may stop above Pmax;
+// then the interval stays as wide as it ended.
+std::pair<double, double> symbolic_mdp_t::reach(
+        mtbdd_t const& target_values,
+        objective_t objective,
+        options_t const& options,
+        util::optional<threshold_t> const& threshold) {
+    auto const& states = reachable_set();
+    auto target = manager.apply(op_t::Mul, states, manager.apply(op_t::Neq, target_values, zero));
+    auto maybe_or_yes = manager.apply(op_t::Mul, states, manager.apply(op_t::Not, prob0(target, objective)));
+    auto infinity = manager.constant(INFINITY);
+    auto bellman = [&](mtbdd_t const& x) {
+        auto x_next = manager.shift(x, 1);
+        auto best = objective == objective_t::Min ? infinity : zero;
+        for (auto const& command : commands) {
+            auto value = manager.abstract(op_t::Add,
+                    manager.apply(op_t::Mul, command.transitions, x_next), next_cube);
+            if (objective == objective_t::Min)
+                best = manager.apply(op_t::Min, best, manager.ite(command.guard, value, infinity));
+            else
+                best = manager.apply(op_t::Max, best, value);
+        }
+        // deadlocks keep their value like a self-loop
+        auto updated = manager.ite(target, one, manager.ite(enabled, best, x));
+        return manager.apply(op_t::Mul, maybe_or_yes, updated);
+    };
+    auto change = [&](mtbdd_t const& from, mtbdd_t const& to) {
+        auto diff = manager.apply(op_t::Sub, to, from);
+        return std::max(manager.max_value(diff), -manager.min_value(diff));
+    };
+
+    // an iteration sums at most `k` products per state, so once anything
+    // was rounded each one adds at most (k+2) eps to the error
+    size_t k = 1;
+    for (auto const& command : compiled.commands)
+        k = std::max(k, command.branches.size());
+    double const eps = std::numeric_limits<double>::epsilon();
+
+    auto lower = target;
+    auto upper = maybe_or_yes;
+    for (size_t iter=0; iter<options.max_iterations; ++iter) {
+        auto next_lower = bellman(lower);
+        auto next_upper = bellman(upper);
+        double moved = std::max(change(lower, next_lower), change(upper, next_upper));
+        lower = next_lower;
+        upper = next_upper;
+        std::pair<double, double> bounds{
+            manager.eval(lower, initial_assignment), manager.eval(upper, initial_assignment)};
+        if (manager.inexact) {
+            double error = (iter + 1) * (k + 2) * eps;
+            bounds.first = std::max(0.0, bounds.first - error);
+            bounds.second = std::min(1.0, bounds.second + error);
+        }
+        double width = manager.max_value(manager.apply(op_t::Sub, upper, lower));
+        if (width < options.precision || moved < options.precision)
+            return bounds;
+        if (threshold && threshold->decide(to_rational(bounds.first), to_rational(bounds.second)) != verdict_t::Unknown)
+            return bounds;
+    }
+    throw std::runtime_error{format(
+            "symbolic interval iteration did not converge in {} iterations", options.max_iterations)};
+}
+
+}
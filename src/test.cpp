@@ -1,11 +1,24 @@
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <sstream>
+#include <thread>
+#include <chrono>
+
 #include "test.hpp"
 #include "expr_ast.hpp"
 #include "parser.hpp"
 #include "evaluator.hpp"
 #include "MDP.hpp"
+#include "mdp_explore.hpp"
+#include "mdp_compile.hpp"
 #include "simple_type.hpp"
 #include "translate.hpp"
 #include "typechecker.hpp"
+#include "checker.hpp"
+#include "bdd.hpp"
+#include "symbolic.hpp"
+#include "PCTL.hpp"
 
 struct lang_feature_test : public test::test_base {
     void parse_test(std::string const& input, std::string const& output) {
@@ -183,16 +196,10 @@ PML_CUSTOM_TEST(typed_test, lang_feature_test) {
 PML_TEST(translation_test) {
     using namespace ast;
     using namespace mdp;
-    assert_eq(
-            translate_to_mdp(ast::int_expr_t{42}).mdp,
-            mdp_t {
-                "default",
-                {},
-                {
-                    mdp::constant_t{"c42", 42}
-                },
-                {}
-            });
+    // literals are inlined as values instead of declared as constants
+    auto translated = translate_to_mdp(ast::int_expr_t{42});
+    assert_eq(translated.mdp, mdp_t{"default", {}, {}, {}});
+    assert_eq(*translated.value.expr(), *make<mdp::int_expr_t>(42));
 }
 
 PML_TEST(translation_rand_test) {
@@ -204,7 +211,7 @@ PML_TEST(translation_rand_test) {
                 "default",
                 {
                     mdp::variable_t{"location", bound_t{0, 1}, 0},
-                    mdp::variable_t{"v0", bound_t{1, 2}, 1}
+                    mdp::variable_t{"_v0", bound_t{1, 2}, 1}
                 },
                 {}, // constants
                 {
@@ -225,7 +232,7 @@ PML_TEST(translation_rand_test) {
                                         make<mdp::int_expr_t>(1),
                                         mdp::binop_kind_t::Eq),
                                     make<mdp::binop_expr_t>(
-                                        make<mdp::var_expr_t>("v0'"),
+                                        make<mdp::var_expr_t>("_v0'"),
                                         make<mdp::int_expr_t>(1),
                                         mdp::binop_kind_t::Eq),
                                     mdp::binop_kind_t::And)
@@ -241,7 +248,7 @@ PML_TEST(translation_rand_test) {
                                         make<mdp::int_expr_t>(1),
                                         mdp::binop_kind_t::Eq),
                                     make<mdp::binop_expr_t>(
-                                        make<mdp::var_expr_t>("v0'"),
+                                        make<mdp::var_expr_t>("_v0'"),
                                         make<mdp::int_expr_t>(2),
                                         mdp::binop_kind_t::Eq),
                                     mdp::binop_kind_t::And)
@@ -252,6 +259,241 @@ PML_TEST(translation_rand_test) {
             });
 }
 
+// `location=4 & a+b=0` in `let a = rand(0, 1) in let b = rand(0, 1) in a+b == 0`
+static mdp::binop_expr_t both_coins_zero() {
+    using namespace mdp;
+    return binop_expr_t{
+        make<binop_expr_t>(make<var_expr_t>("location"), make<int_expr_t>(4), binop_kind_t::Eq),
+        make<binop_expr_t>(
+            make<binop_expr_t>(make<var_expr_t>("a"), make<var_expr_t>("b"), binop_kind_t::Add),
+            make<int_expr_t>(0), binop_kind_t::Eq),
+        binop_kind_t::And};
+}
+
+PML_TEST(command_index_test) {
+    using namespace mdp;
+    auto mdp = translate_to_mdp(*parser::parse(
+                "let a = rand(0, 1) in let b = rand(0, 1) in a+b == 0").ok()).mdp;
+    auto index = mdp.index_commands();
+    assert_eq(index.unlocated.size(), 0u);
+    size_t indexed = 0;
+    for (auto const& p : index.by_location) {
+        for (auto i : p.second)
+            assert_eq(*guard_location(*mdp.commands[i].guard), p.first);
+        indexed += p.second.size();
+    }
+    assert_eq(indexed, mdp.commands.size());
+
+    // 1 initial, 2 after `a`, 2 after binding, 4 after `b`, 4 after binding
+    auto model = explore(mdp);
+    assert_eq(model.state_count(), 13u);
+    assert_eq(model.choice_count(), 13u);
+
+    successor_generator_t generator{mdp};
+    auto target = generator.compile(both_coins_zero());
+    // names are resolved to slots and constants are folded
+    assert_eq(target.code.size(), 9u);
+    size_t both_zero = 0;
+    for (auto const& s : model.states) {
+        if (target.eval(s))
+            ++both_zero;
+    }
+    assert_eq(both_zero, 1u);
+}
+
+PML_TEST(chain_fusion_test) {
+    auto fused = translate_to_mdp(*parser::parse(
+                "let a = rand(0, 1) in let b = rand(0, 1) in a+b == 0").ok());
+    fuse_deterministic_chains(fused);
+    // the bindings of `a` and `b` happen with the `rand`s
+    assert_eq(fused.mdp.commands.size(), 2u);
+    assert_eq(fused.accept, 2);
+    auto model = mdp::explore(fused.mdp);
+    assert_eq(model.state_count(), 7u);
+
+    auto pctl = translate_to_pctl(parser::parse_reftype("{x:bool | Prob(x) <= 1/4}").ok(), fused);
+    assert_(checker::check(fused.mdp, pctl, checker::options_t{}) == checker::verdict_t::True, "Prob(x) <= 1/4");
+    pctl = translate_to_pctl(parser::parse_reftype("{x:bool | Prob(x) <= 1/5}").ok(), fused);
+    assert_(checker::check(fused.mdp, pctl, checker::options_t{}) == checker::verdict_t::False, "not Prob(x) <= 1/5");
+
+    auto three = translate_to_mdp(*parser::parse(
+                "let a = rand(0, 1) in let b = rand(0, 2) in let c = rand(0, 3) in a+b+c == 6").ok());
+    auto expected = mdp::explore(three.mdp).state_count();
+    fuse_deterministic_chains(three);
+    assert_eq(three.mdp.commands.size(), 3u);
+    assert_(mdp::explore(three.mdp).state_count() < expected, "fewer states");
+    pctl = translate_to_pctl(parser::parse_reftype("{x:bool | Prob(x) >= 1/24}").ok(), three);
+    assert_(checker::check(three.mdp, pctl, checker::options_t{}) == checker::verdict_t::True, "Prob(x) >= 1/24");
+}
+
+PML_TEST(wide_rand_test) {
+    auto branch_count = [](mdp::mdp_t const& mdp) {
+        size_t count = 0;
+        for (auto const& command : mdp.commands)
+            count += command.branches.size();
+        return count;
+    };
+    // 10000 = 2^4 * 5^4 is drawn exactly by two digits, 2500 and 4
+    auto exact = translate_to_mdp(*parser::parse("rand(0, 9999)").ok());
+    assert_eq(branch_count(exact.mdp), 2504u);
+    auto model = mdp::explore(exact.mdp);
+    assert_(static_cast<bool>(checker::topological_order(model)), "no redraws");
+    size_t finals = 0;
+    for (auto const& s : model.states)
+        finals += s[0] == exact.accept;
+    assert_eq(finals, 10000u);
+
+    // 4099 is prime but small enough for a single command
+    auto prime = translate_to_mdp(*parser::parse("rand(0, 4098)").ok());
+    assert_eq(prime.mdp.commands.size(), 1u);
+
+    // 65537 is prime, so 65538 = 2 * 3^2 * 11 * 331 values are drawn and 65537 redrawn
+    std::string program = "let a = rand(0, 65536) in a <= 32767";
+    auto redrawn = translate_to_mdp(*parser::parse(program).ok());
+    assert_(branch_count(redrawn.mdp) < 5000, "digits instead of 65537 branches");
+    for (auto type : {"{x:bool | Prob(x) >= 32768/65537}", "{x:bool | Prob(x) <= 32768/65537}"}) {
+        auto pctl = translate_to_pctl(parser::parse_reftype(type).ok(), redrawn);
+        assert_(checker::check(redrawn.mdp, pctl, checker::options_t{}) == checker::verdict_t::True, type);
+    }
+}
+
+PML_TEST(rand_abstraction_test) {
+    // only `a >= 5` is observed, so 21 outcomes fall into 2 classes
+    auto compared = translate_to_mdp(*parser::parse("let a = rand(-10, 10) in a >= 5").ok());
+    fuse_deterministic_chains(compared);
+    abstract_rand_branches(compared);
+    assert_eq(compared.mdp.commands.size(), 1u);
+    assert_eq(compared.mdp.commands[0].branches.size(), 2u);
+    assert_eq(mdp::explore(compared.mdp).state_count(), 3u);
+    for (auto type : {"{x:bool | Prob(x) >= 2/7}", "{x:bool | Prob(x) <= 2/7}"}) {
+        auto pctl = translate_to_pctl(parser::parse_reftype(type).ok(), compared);
+        assert_(checker::check(compared.mdp, pctl, checker::options_t{}) == checker::verdict_t::True, type);
+    }
+
+    // `a*2` reads the value itself
+    auto computed = translate_to_mdp(*parser::parse("let a = rand(-10, 10) in a*2 >= 5").ok());
+    fuse_deterministic_chains(computed);
+    abstract_rand_branches(computed);
+    assert_eq(computed.mdp.commands[0].branches.size(), 21u);
+
+    // the property tells apart the outcomes that `n >= 4` lumps together
+    checker::options_t options;
+    options.engine = checker::engine_t::Native;
+    auto lumped = [](std::string const& bound) {
+        return "let n = rand(0, 7) in ((n >= 4) : {x:bool | Prob(x /\\ n = 4) " + bound + "})";
+    };
+    assert_(typechecker::typecheck(*parser::parse(lumped("<= 1/8")).ok(), options), "Prob(x /\\ n = 4) <= 1/8");
+    assert_(typechecker::typecheck(*parser::parse(lumped(">= 1/8")).ok(), options), "Prob(x /\\ n = 4) >= 1/8");
+    auto unread = [](std::string const& bound) {
+        return "let n = rand(1, 2) in (rand(0, 3) : {x:int | Prob(x >= n) " + bound + "})";
+    };
+    assert_(typechecker::typecheck(*parser::parse(unread(">= 5/8")).ok(), options), "Prob(x >= n) >= 5/8");
+    assert_(typechecker::typecheck(*parser::parse(unread("<= 5/8")).ok(), options), "Prob(x >= n) <= 5/8");
+    assert_(!typechecker::typecheck(*parser::parse(unread(">= 3/4")).ok(), options), "not Prob(x >= n) >= 3/4");
+}
+
+PML_TEST(dead_variable_test) {
+    std::string coin = "let a = rand(0, 1) in let b = rand(0, 1) in a+b == 0";
+    // `_v0`, `_v1` and `b` are never live at the same time
+    auto shared = translate_to_mdp(*parser::parse(coin).ok());
+    reuse_dead_variables(shared);
+    assert_eq(shared.mdp.variables.size(), 3u);
+    auto pctl = translate_to_pctl(parser::parse_reftype("{x:bool | Prob(x) <= 1/4}").ok(), shared);
+    assert_(checker::check(shared.mdp, pctl, checker::options_t{}) == checker::verdict_t::True, "Prob(x) <= 1/4");
+    pctl = translate_to_pctl(parser::parse_reftype("{x:bool | Prob(x) >= 1/4}").ok(), shared);
+    assert_(checker::check(shared.mdp, pctl, checker::options_t{}) == checker::verdict_t::True, "Prob(x) >= 1/4");
+
+    // `a` and `b` are never read, so their values stop splitting states
+    auto unused = translate_to_mdp(*parser::parse(
+                "let a = rand(0, 3) in let b = rand(0, 3) in let c = rand(0, 3) in c == 0").ok());
+    fuse_deterministic_chains(unused);
+    assert_eq(mdp::explore(unused.mdp).state_count(), 85u);
+    reuse_dead_variables(unused);
+    assert_eq(mdp::explore(unused.mdp).state_count(), 7u);
+    pctl = translate_to_pctl(parser::parse_reftype("{x:bool | Prob(x) >= 1/4}").ok(), unused);
+    assert_(checker::check(unused.mdp, pctl, checker::options_t{}) == checker::verdict_t::True, "Prob(x) >= 1/4");
+
+    // `n` is only read by the property, so it stays live to the end
+    auto observed = translate_to_mdp(*parser::parse("let n = rand(1, 2) in rand(0, 3)").ok());
+    fuse_deterministic_chains(observed);
+    reuse_dead_variables(observed, {"n"});
+    for (auto bound : {">= 5/8", "<= 5/8"}) {
+        pctl = translate_to_pctl(parser::parse_reftype(std::string{"{x:int | Prob(x >= n) "} + bound + "}").ok(), observed);
+        assert_(checker::check(observed.mdp, pctl, checker::options_t{}) == checker::verdict_t::True, bound);
+    }
+}
+
+PML_TEST(merge_test) {
+    using namespace mdp;
+    mdp_t lhs{"default", {variable_t{"x", bound_t{0, 1}, 0}}, {constant_t{"c1", 1}}, {}};
+    mdp_t rhs{"default",
+        {variable_t{"y", bound_t{0, 1}, 0}, variable_t{"x", bound_t{2, 3}, 0}},
+        {constant_t{"c1", 1}}, {}};
+    auto merged = mdp_t::merge(std::move(lhs), std::move(rhs));
+    assert_eq(merged.variables.size(), 2u);
+    assert_eq(merged.constants.size(), 1u);
+    for (auto const& var : merged.variables) {
+        if (var.name == "x")
+            assert_(var.as_int().bound.min == 0 && var.as_int().bound.max == 3, "bounds of both sides");
+    }
+
+    // a long chain of `let`s translates in near-linear time
+    std::string program;
+    size_t n = 3000;
+    for (size_t i=0; i<n; ++i)
+        program += "let x" + std::to_string(i) + " = rand(0, 1) in ";
+    program += "x0";
+    auto mdp = translate_to_mdp(*parser::parse(program).ok()).mdp;
+    // each `let` declares a `rand` result and its name; one `location`
+    assert_eq(mdp.variables.size(), 2 * n + 1);
+}
+
+PML_TEST(concurrent_translation_test) {
+    auto program = parser::parse(
+            "let a = rand(0, 1) in let b = rand(0, 1) in if a == b then a else b").ok();
+    auto expected = translate_to_mdp(*program);
+    // fresh names restart for every translation, even interleaved ones
+    std::vector<mdp_with_info_t> results(4);
+    std::vector<std::thread> threads;
+    for (auto& result : results)
+        threads.emplace_back([&] { result = translate_to_mdp(*program); });
+    for (auto& thread : threads)
+        thread.join();
+    for (auto const& result : results) {
+        assert_eq(result.mdp, expected.mdp);
+        assert_eq(result.accept, expected.accept);
+        assert_eq(result.value.name, expected.value.name);
+    }
+}
+
+PML_TEST(determinism_test) {
+    auto translated = translate_to_mdp(*parser::parse(
+                "letfun f n:int -> int = if n <= 0 then 0 else rand(0, 1) + f (n - 1) in "
+                "if rand(0, 1) == 0 then f 2 else f 3").ok());
+    fuse_deterministic_chains(translated);
+    abstract_rand_branches(translated);
+    reuse_dead_variables(translated);
+    assert_(mdp::is_deterministic(translated.mdp), "translations are deterministic");
+    std::ostringstream model;
+    model << translated.mdp;
+    assert_eq(model.str().substr(0, 4), std::string{"dtmc"});
+
+    auto type = parser::parse_reftype("{x:int | Prob(x >= 3) <= 1/2}").ok();
+    std::ostringstream property;
+    translate_to_pctl(type, translated).output(property);
+    assert_eq(property.str().substr(0, 4), std::string{"(P=?"});
+
+    // another command at a location of a `rand`
+    auto const& draw = *std::find_if(
+            translated.mdp.commands.begin(), translated.mdp.commands.end(),
+            [](mdp::command_t const& command) { return command.branches.size() == 2; });
+    translated.mdp.commands.push_back(draw);
+    assert_(!mdp::is_deterministic(translated.mdp), "overlapping guards");
+    property.str("");
+    translate_to_pctl(type, translated).output(property);
+    assert_eq(property.str().substr(0, 6), std::string{"(Pmax="});
+}
+
 PML_TEST(parsing_formula_test) {
     std::string input = "true \\/ true /\\ false";
     parser::parse_formula(input).case_of(
@@ -471,6 +713,451 @@ PML_TEST(typecheck_test) {
         "can not type `let a = rand(0, 1) in a : {x:int | Prob(x=0) = 1/2}`");
 }
 
+struct native_check_test : public test::test_base {
+    checker::verdict_t verdict(std::string const& program, std::string const& type,
+            checker::options_t const& options = checker::options_t{}) {
+        auto mdp_with_info = translate_to_mdp(*parser::parse(program).ok());
+        auto pctl = translate_to_pctl(parser::parse_reftype(type).ok(), mdp_with_info);
+        return checker::check(mdp_with_info.mdp, pctl, options);
+    }
+    bool check(std::string const& program, std::string const& type,
+            checker::options_t const& options = checker::options_t{}) {
+        return verdict(program, type, options) == checker::verdict_t::True;
+    }
+};
+
+PML_CUSTOM_TEST(topological_sweep_test, native_check_test) {
+    std::string coin = "let a = rand(0, 1) in let b = rand(0, 1) in a+b == 0";
+    auto model = mdp::explore(translate_to_mdp(*parser::parse(coin).ok()).mdp);
+    assert_(static_cast<bool>(checker::topological_order(model)), "coin flip is acyclic");
+    assert_(check(coin, "{x:bool | Prob(x) <= 1/4}"), "Prob(x) <= 1/4");
+    assert_(check(coin, "{x:bool | Prob(x) >= 1/4}"), "Prob(x) >= 1/4");
+    assert_(!check(coin, "{x:bool | Prob(x) <= 1/5}"), "not Prob(x) <= 1/5");
+
+    // halves are exact doubles, so the sweep is exact
+    checker::options_t swept;
+    swept.exact_threshold = 0;
+    assert_(check(coin, "{x:bool | Prob(x) <= 1/4}", swept), "Prob(x) <= 1/4 by the sweep");
+    // tenths are not: the rounded sum lands on either side of 1/10
+    std::string tenth = "let a = rand(0, 9) in let b = rand(0, 300) in a + b - b == 1";
+    swept.bisimulation = false;
+    assert_(checker::verdict_t::Unknown == verdict(tenth, "{x:bool | Prob(x) <= 1/10}", swept), "rounding is no proof");
+    assert_(checker::verdict_t::Unknown == verdict(tenth, "{x:bool | Prob(x) >= 1/10}", swept), "either way");
+    swept.exact_threshold = 1000;
+    assert_(check(tenth, "{x:bool | Prob(x) <= 1/10}", swept), "Prob(x) <= 1/10 by an exact sweep");
+    assert_(check(tenth, "{x:bool | Prob(x) >= 1/10}", swept), "Prob(x) >= 1/10 by an exact sweep");
+    assert_(!check(tenth, "{x:bool | Prob(x) <= 99/1000}", swept), "not Prob(x) <= 99/1000");
+}
+
+PML_CUSTOM_TEST(function_call_test, native_check_test) {
+    // the body is translated once, however often it is called
+    std::string calls = "letfun f n:int -> int = n + rand(0, 1) in f 1 + f (f 2)";
+    auto translated = translate_to_mdp(*parser::parse(calls).ok());
+    auto draws = std::count_if(
+            translated.mdp.commands.begin(), translated.mdp.commands.end(),
+            [](mdp::command_t const& command) { return command.branches.size() == 2; });
+    assert_eq(draws, 1);
+    assert_(check(calls, "{x:int | Prob(x >= 6) >= 1/8}"), "Prob(x >= 6) >= 1/8");
+    assert_(check(calls, "{x:int | Prob(x >= 6) <= 1/8}"), "Prob(x >= 6) <= 1/8");
+
+    // recursion saves the frame of the caller
+    auto calc = [](std::string const& n, std::string const& bound) {
+        return "letfun main n:int -> {x:int | Prob(x >= 10*n) " + bound + "} =\n"
+            "    if n <= 0 then 1 else rand(1, 10) + main (n - 1)\n"
+            "in main " + n;
+    };
+    checker::options_t options;
+    options.engine = checker::engine_t::Native;
+    assert_(typechecker::typecheck(*parser::parse(calc("3", "<= 4/1000")).ok(), options), "Prob(x >= 30) <= 4/1000");
+    assert_(!typechecker::typecheck(*parser::parse(calc("3", "<= 3/1000")).ok(), options), "not Prob(x >= 30) <= 3/1000");
+
+    // the depth is derived from `n <= 0` and `n - 1`
+    auto variables = translate_to_mdp(*parser::parse(calc("3", "<= 4/1000")).ok()).mdp.variables;
+    auto sp = std::find_if(variables.begin(), variables.end(),
+            [](mdp::variable_t const& var) { return var.name == "_main_sp"; });
+    assert_(sp != variables.end(), "_main_sp");
+    assert_eq(sp->as_int().bound.max, 3);
+
+    // 11 activations overflow a stack of the default depth, which is not
+    // derived through `m`
+    auto down = [](std::string const& n) {
+        return "letfun down n:int -> {x:int | Prob(x <= 0) >= 1/2} =\n"
+            "    if n <= 0 then 0 else let m = n - 1 in 0 + down m\n"
+            "in down " + n;
+    };
+    assert_(typechecker::typecheck(*parser::parse(down("5")).ok(), options), "6 activations");
+    assert_(!typechecker::typecheck(*parser::parse(down("10")).ok(), options), "overflow");
+    // an overflow is not a run that never returns
+    auto up = "letfun g n:int -> {x:int | Prob(x >= 20) <= 0} =\n"
+        "    if n >= 20 then n else g (n + 1)\n"
+        "in g 0";
+    assert_(!typechecker::typecheck(*parser::parse(up).ok(), options), "overflow with an upper bound");
+
+    // annotations within a body are not checked through the return type
+    bool rejected = false;
+    try {
+        typechecker::typecheck(*parser::parse(
+                "letfun h n:int -> int = (n + rand(0, 1)) : {x:int | Prob(x >= 9) >= 1} in h 1").ok(), options);
+    } catch (std::runtime_error const&) {
+        rejected = true;
+    }
+    assert_(rejected, "annotation in a body");
+    options.max_depth = 11;
+    assert_(typechecker::typecheck(*parser::parse(down("10")).ok(), options), "11 activations");
+
+    // tail calls need no stack
+    std::string walk =
+        "letfun walk (x:int, n:int) -> int =\n"
+        "    if n <= 0 then x else if rand(0, 1) <= 0 then walk (x - 1) (n - 1) else walk x (n - 1)\n"
+        "in walk 0 20";
+    variables = translate_to_mdp(*parser::parse(walk).ok()).mdp.variables;
+    assert_(std::none_of(variables.begin(), variables.end(),
+                [](mdp::variable_t const& var) { return var.name == "_walk_sp"; }), "no _walk_sp");
+    assert_(check(walk, "{x:int | Prob(x <= -20) <= 1/1000000}"), "Prob(x <= -20) <= 1/1000000");
+
+    // a parameter that shadows a `let` has a variable of its own
+    std::string shadowed = "let n = rand(0, 1) in letfun f n:int -> int = n + 1 in f 5 + n";
+    assert_(check(shadowed, "{x:int | Prob(x >= 7) >= 1/2}"), "Prob(x >= 7) >= 1/2");
+    assert_(check(shadowed, "{x:int | Prob(x >= 7) <= 1/2}"), "Prob(x >= 7) <= 1/2");
+    shadowed = "let n = rand(0, 1) in letfun f n:int -> int = n + 1 in f 1 + n";
+    assert_(check(shadowed, "{x:int | Prob(x >= 3) <= 1/2}"), "the outer n is kept");
+}
+
+PML_CUSTOM_TEST(shared_formula_test, native_check_test) {
+    // every operator is one formula over the names of its operands
+    std::string sum = "let a = rand(0, 1) in let b = rand(0, 1) in a";
+    for (int i=1; i<64; ++i)
+        sum += i % 2 ? " + b" : " + a";
+    sum += " >= 32";
+    auto translated = translate_to_mdp(*parser::parse(sum).ok());
+    assert_eq(translated.mdp.formulas.size(), 64u);
+    for (auto const& formula : translated.mdp.formulas)
+        assert_(format("{}", *formula.value).size() <= 8, "formulas are over names");
+    assert_(check(sum, "{x:bool | Prob(x) >= 3/4}"), "Prob(x) >= 3/4");
+    assert_(check(sum, "{x:bool | Prob(x) <= 3/4}"), "Prob(x) <= 3/4");
+
+    // formulas that read a variable assigned by a fused step are written
+    // out, and the ones nothing reads any more are dropped with their variables
+    fuse_deterministic_chains(translated);
+    abstract_rand_branches(translated);
+    reuse_dead_variables(translated);
+    assert_(translated.mdp.formulas.size() <= 64u, "no new formulas");
+    auto pctl = translate_to_pctl(parser::parse_reftype("{x:bool | Prob(x) >= 3/4}").ok(), translated);
+    assert_(checker::check(translated.mdp, pctl, checker::options_t{}) == checker::verdict_t::True, "after the passes");
+
+    // generated names can not be taken by bindings of the program
+    std::string shadowing = "let f0 = rand(0, 1) in let v0 = rand(0, 1) in f0 + v0 + 1 >= 3";
+    assert_(check(shadowing, "{x:bool | Prob(x) >= 1/4}"), "Prob(x) >= 1/4");
+    assert_(check(shadowing, "{x:bool | Prob(x) <= 1/4}"), "Prob(x) <= 1/4");
+    std::string param = "letfun g f0:int -> int = if f0 <= 0 then 0 else 1 + g (f0 - 1) in g 3";
+    assert_(check(param, "{x:int | Prob(x = 3) >= 1}"), "g 3 = 3");
+    std::string frame = "letfun f n:int -> int = n + 1 in let f_ret = rand(0, 1) in f 5 + f 6 + f_ret";
+    assert_(check(frame, "{x:int | Prob(x >= 14) <= 1/2}"), "Prob(x >= 14) <= 1/2");
+    assert_(check(frame, "{x:int | Prob(x >= 14) >= 1/2}"), "Prob(x >= 14) >= 1/2");
+}
+
+PML_CUSTOM_TEST(literal_test, native_check_test) {
+    // `true` and `1` used to share the constant `c1`
+    std::string program = "let x = rand(-3, 4) in if true then x != 1 /\\ x != -3 else false";
+    auto translated = translate_to_mdp(*parser::parse(program).ok());
+    assert_(translated.mdp.constants.empty(), "literals are inlined");
+    assert_(check(program, "{x:bool | Prob(x) >= 3/4}"), "Prob(x) >= 3/4");
+    assert_(check(program, "{x:bool | Prob(x) <= 3/4}"), "Prob(x) <= 3/4");
+}
+
+// 0 -a-> 1 (deadlock), 0 -b-> {2 (target), 3} with 1/2 each, 3 -> 0
+static mdp::explicit_mdp_t small_cyclic_model() {
+    mdp::explicit_mdp_t model;
+    model.states = {{0}, {1}, {2}, {3}};
+    model.choice_begin = {0, 2, 3, 4, 5};
+    model.transition_begin = {0, 1, 3, 4, 5, 6};
+    model.successors = {1, 2, 3, 1, 2, 0};
+    model.probs = {1.0, 0.5, 0.5, 1.0, 1.0, 1.0};
+    return model;
+}
+
+PML_TEST(precompute_test) {
+    auto model = small_cyclic_model();
+    std::vector<bool> target{false, false, true, false};
+    assert_(checker::prob0a(model, target) == std::vector<bool>{false, true, false, false}, "prob0A");
+    assert_(checker::prob0e(model, target) == std::vector<bool>{true, true, false, true}, "prob0E");
+    assert_(checker::prob1e(model, target) == std::vector<bool>{true, false, true, true}, "prob1E");
+    assert_(checker::prob1a(model, target) == std::vector<bool>{false, false, true, false}, "prob1A");
+    auto pmax = checker::reach_probability(model, target, checker::objective_t::Max, checker::options_t{});
+    assert_eq(pmax[0], 1.0);
+    auto pmin = checker::reach_probability(model, target, checker::objective_t::Min, checker::options_t{});
+    assert_eq(pmin[0], 0.0);
+}
+
+PML_TEST(scc_decomposition_test) {
+    auto model = small_cyclic_model();
+    std::vector<bool> states(model.state_count(), true), choices(model.choice_count(), true);
+    auto sccs = checker::strongly_connected_components(model, states, choices);
+    assert_eq(sccs.size(), 3u);
+    std::sort(sccs.back().begin(), sccs.back().end());
+    assert_(sccs.back() == std::vector<size_t>{0, 3}, "the SCC of the initial state comes last");
+
+    checker::options_t options;
+    options.iteration = checker::iteration_t::Value;
+    auto pmax = checker::reach_probability(model, {false, true, false, false}, checker::objective_t::Max, options);
+    assert_eq(pmax[0], 1.0);
+    auto pmin = checker::reach_bounds(model, {false, false, true, false}, checker::objective_t::Min, checker::options_t{});
+    assert_eq(pmin.upper[3], 0.0);
+}
+
+PML_TEST(bisimulation_test) {
+    // 0 -> {1, 2} with 1/2 each, 1 -> 3, 2 -> 3 (target), 3 -> 3
+    mdp::explicit_mdp_t model;
+    model.states = {{0}, {1}, {2}, {3}};
+    model.choice_begin = {0, 1, 2, 3, 4};
+    model.transition_begin = {0, 2, 3, 4, 5};
+    model.successors = {1, 2, 3, 3, 3};
+    model.probs = {0.5, 0.5, 1.0, 1.0, 1.0};
+    std::vector<bool> target{false, false, false, true};
+    auto quotient = checker::bisimulation_quotient(model, target);
+    assert_eq(quotient.model.state_count(), 3u);
+    assert_eq(quotient.block_of[0], 0u);
+    assert_eq(quotient.block_of[1], quotient.block_of[2]);
+    assert_(quotient.target == std::vector<bool>{false, false, true}, "target blocks");
+    assert_eq(quotient.model.probs[0], 1.0);
+
+    auto ec = small_cyclic_model();
+    std::vector<bool> ec_target{false, false, true, false};
+    auto minimized = checker::bisimulation_quotient(ec, ec_target);
+    auto x = checker::reach_exact(minimized.model, minimized.target, checker::objective_t::Max);
+    auto y = checker::reach_exact(ec, ec_target, checker::objective_t::Max);
+    assert_(x[0] == y[0], "Pmax is preserved");
+}
+
+PML_CUSTOM_TEST(exact_probability_test, native_check_test) {
+    // blocks of the quotient sum 1/100s and 1/10s, whose doubles do not add up
+    std::string tenth = "let a = rand(0, 99) in a <= 9";
+    auto model = mdp::explore(translate_to_mdp(*parser::parse(tenth).ok()).mdp);
+    assert_(model.is_exact(), "probabilities are known exactly");
+    assert_(check(tenth, "{x:bool | Prob(x) >= 1/10}"), "Prob(x) >= 1/10");
+    assert_(check(tenth, "{x:bool | Prob(x) <= 1/10}"), "Prob(x) <= 1/10");
+    std::string sum = "let a = rand(0, 9) in let b = a + a in b <= 4";
+    assert_(check(sum, "{x:bool | Prob(x) <= 3/10}"), "Prob(x) <= 3/10");
+    assert_(check(sum, "{x:bool | Prob(x) >= 3/10}"), "Prob(x) >= 3/10");
+    assert_(!check(sum, "{x:bool | Prob(x) <= 29/100}"), "not Prob(x) <= 29/100");
+}
+
+PML_CUSTOM_TEST(on_the_fly_test, native_check_test) {
+    std::string coin = "let a = rand(0, 1) in let b = rand(0, 1) in a+b == 0";
+    auto mdp = translate_to_mdp(*parser::parse(coin).ok()).mdp;
+    mdp::successor_generator_t generator{mdp};
+    mdp::partial_explorer_t explorer{generator, generator.compile(both_coins_zero())};
+    explorer.expand(1);
+    assert_(!explorer.complete(), "only the initial state is expanded");
+    std::vector<bool> frontier;
+    auto partial = explorer.snapshot(frontier);
+    assert_eq(partial.state_count(), 3u);
+    assert_(!frontier[0] && frontier[1] && frontier[2], "successors of the initial state are the frontier");
+    explorer.expand(100);
+    assert_(explorer.complete(), "everything is expanded");
+
+    checker::options_t options;
+    options.exploration = checker::exploration_t::OnTheFly;
+    assert_(check(coin, "{x:bool | Prob(x) <= 1/4}", options), "Prob(x) <= 1/4 on the fly");
+    options.exact_threshold = 0;
+    assert_(!check(coin, "{x:bool | Prob(x) <= 1/5}", options), "not Prob(x) <= 1/5 on the fly");
+}
+
+PML_TEST(policy_iteration_test) {
+    // 0 -> {1 (target): 1/3, 2 (sink): 1/3, 0: 1/3}
+    mdp::explicit_mdp_t model;
+    model.states = {{0}, {1}, {2}};
+    model.choice_begin = {0, 1, 2, 3};
+    model.transition_begin = {0, 3, 4, 5};
+    model.successors = {1, 2, 0, 1, 2};
+    model.probs = {1.0/3, 1.0/3, 1.0/3, 1.0, 1.0};
+    model.exact_probs = {checker::rational_t{1}, checker::rational_t{1} / 3};
+    model.exact_of = {1, 1, 1, 0, 0};
+    auto x = checker::reach_exact(model, {false, true, false}, checker::objective_t::Min);
+    assert_(x[0] == checker::rational_t{1} / 2, "Pmin is exactly 1/2");
+
+    // the end component {0, 1} has to be left through 0 -b-> {2, 3}
+    auto ec = small_cyclic_model();
+    ec.successors = {1, 2, 3, 0, 2, 3};
+    auto pmax = checker::reach_exact(ec, {false, false, true, false}, checker::objective_t::Max);
+    assert_(pmax[0] == checker::rational_t{1} / 2, "Pmax is exactly 1/2");
+    assert_(pmax[1] == checker::rational_t{1} / 2, "Pmax of the end component");
+}
+
+// i -> {i+1: 0.9, sink: 0.05, 0: 0.05}, the last state before the sink is the target
+PML_TEST(parallel_iteration_test) {
+    size_t n = 1 << 16;
+    mdp::explicit_mdp_t model;
+    model.states.resize(n + 1);
+    model.choice_begin.push_back(0);
+    model.transition_begin.push_back(0);
+    for (size_t s=0; s<=n; ++s) {
+        if (s + 1 < n) {
+            model.successors.insert(model.successors.end(), {s + 1, n, 0});
+            model.probs.insert(model.probs.end(), {0.9, 0.05, 0.05});
+        } else {
+            model.successors.push_back(s);
+            model.probs.push_back(1.0);
+        }
+        model.transition_begin.push_back(model.successors.size());
+        model.choice_begin.push_back(s + 1);
+    }
+    std::vector<bool> target(n + 1, false);
+    target[n - 1] = true;
+
+    checker::options_t options;
+    options.iteration = checker::iteration_t::Value;
+    options.threads = 1;
+    auto sequential = checker::reach_probability(model, target, checker::objective_t::Max, options);
+    options.threads = 4;
+    auto parallel = checker::reach_probability(model, target, checker::objective_t::Max, options);
+    assert_(sequential == parallel, "deterministic regardless of threads");
+    assert_(sequential[n - 2] >= 0.9, "converged");
+}
+
+// i -> {i+1: 0.8, sink: 0.1, 0: 0.1}, the end of the chain is the target
+PML_TEST(gauss_seidel_test) {
+    size_t n = 50;
+    mdp::explicit_mdp_t model;
+    model.states.resize(n + 1);
+    model.choice_begin.push_back(0);
+    model.transition_begin.push_back(0);
+    for (size_t s=0; s<=n; ++s) {
+        if (s + 1 < n) {
+            model.successors.insert(model.successors.end(), {s + 1, n, 0});
+            model.probs.insert(model.probs.end(), {0.8, 0.1, 0.1});
+        } else {
+            model.successors.push_back(s);
+            model.probs.push_back(1.0);
+        }
+        model.transition_begin.push_back(model.successors.size());
+        model.choice_begin.push_back(s + 1);
+    }
+    std::vector<bool> target(n + 1, false);
+    target[n - 1] = true;
+
+    checker::options_t options;
+    options.max_iterations = 20;
+    bool jacobi_converged = true;
+    try {
+        checker::reach_bounds(model, target, checker::objective_t::Min, options);
+    } catch (std::runtime_error const&) {
+        jacobi_converged = false;
+    }
+    assert_(!jacobi_converged, "Jacobi needs a sweep per chain step");
+
+    options.method = checker::method_t::GaussSeidel;
+    auto bounds = checker::reach_bounds(model, target, checker::objective_t::Min, options);
+    assert_(bounds.upper[0] - bounds.lower[0] < options.precision, "Gauss-Seidel converged");
+
+    options.iteration = checker::iteration_t::Value;
+    options.method = checker::method_t::SOR;
+    options.max_iterations = 1000;
+    auto x = checker::reach_probability(model, target, checker::objective_t::Min, options);
+    assert_(std::abs(x[0] - bounds.lower[0]) < 1e-5, "SOR agrees");
+}
+
+PML_TEST(variable_order_test) {
+    using namespace mdp;
+    auto var = [](std::string const& name) {
+        return make<var_expr_t>(name);
+    };
+    auto eq = [](ptr<expr_t> lhs, int n) {
+        return make<binop_expr_t>(lhs, make<int_expr_t>(n), binop_kind_t::Eq);
+    };
+    // x and z are used together, y alone
+    mdp_t model;
+    model.variables.emplace_back("x", bound_t{0, 1}, 0);
+    model.variables.emplace_back("y", bound_t{0, 1}, 0);
+    model.variables.emplace_back("z", bound_t{0, 1}, 0);
+    model.commands.push_back(command_t{eq(var("x"), 0), {branch_t{make<int_expr_t>(1), eq(var("z'"), 1)}}});
+    model.commands.push_back(command_t{eq(var("y"), 0), {branch_t{make<int_expr_t>(1), eq(var("y'"), 1)}}});
+    auto order = variable_order(compiled_mdp_t{model});
+    assert_(order == std::vector<std::uint32_t>{0, 2, 1}, "x and z are adjacent");
+    order_variables(model);
+    assert_eq(model.variables[1].name, "z");
+
+    // `location` is tested by every command and comes first
+    auto translated = translate_to_mdp(*parser::parse("let a = rand(0, 1) in a == 0").ok()).mdp;
+    order_variables(translated);
+    assert_eq(translated.variables[0].name, "location");
+}
+
+PML_CUSTOM_TEST(symbolic_test, native_check_test) {
+    bdd::manager_t manager;
+    auto x = manager.variable(0), y = manager.variable(1);
+    auto f = manager.apply(bdd::op_t::And, x, y);
+    auto g = manager.apply(bdd::op_t::Not, manager.apply(bdd::op_t::Or,
+                manager.apply(bdd::op_t::Not, x), manager.apply(bdd::op_t::Not, y)));
+    assert_(f == g, "nodes are canonical");
+    auto sum = manager.abstract(bdd::op_t::Add, f, manager.cube({0, 1}));
+    assert_eq(manager.value(sum), 1.0);
+    assert_eq(manager.eval(manager.shift(x, 1), {false, true}), 1.0);
+    // the branch that is not taken may be infinite
+    auto bounded = manager.ite(x, manager.constant(0.5), manager.constant(INFINITY));
+    assert_eq(manager.eval(bounded, {true, false}), 0.5);
+
+    std::string coin = "let a = rand(0, 1) in let b = rand(0, 1) in a+b == 0";
+    auto mdp = translate_to_mdp(*parser::parse(coin).ok()).mdp;
+    checker::symbolic_mdp_t symbolic{mdp};
+    assert_eq(symbolic.reachable_states(), (double)mdp::explore(mdp).state_count());
+
+    checker::options_t options;
+    options.engine = checker::engine_t::Symbolic;
+    assert_(check(coin, "{x:bool | Prob(x) <= 1/4}", options), "Prob(x) <= 1/4 symbolically");
+    assert_(!check(coin, "{x:bool | Prob(x) <= 1/5}", options), "not Prob(x) <= 1/5 symbolically");
+    assert_(check(coin, "{x:bool | Prob(x) >= 1/5}", options), "Prob(x) >= 1/5 symbolically");
+    // a converged lower bound is no upper bound, and tenths are rounded
+    std::string tenth = "let a = rand(0, 9) in let b = rand(0, 300) in a + b - b == 1";
+    assert_(checker::verdict_t::Unknown == verdict(tenth, "{x:bool | Prob(x) <= 1/10}", options), "1/10 is undecided");
+    assert_(!check(tenth, "{x:bool | Prob(x) <= 1/20}", options), "not Prob(x) <= 1/20 symbolically");
+    assert_(check(tenth, "{x:bool | Prob(x) <= 1/5}", options), "Prob(x) <= 1/5 symbolically");
+
+    // wide ranges are encoded bit by bit, so they take no time
+    auto start = std::chrono::steady_clock::now();
+    std::string wide = "let a = rand(0, 8191) in a >= 100";
+    assert_(check(wide, "{x:bool | Prob(x) >= 49/50}", options), "Prob(x) >= 49/50 over 8192 values");
+    assert_(!check(wide, "{x:bool | Prob(x) >= 99/100}", options), "not Prob(x) >= 99/100 over 8192 values");
+    std::string sum = "let a = rand(0, 999) in let b = rand(0, 999) in a + b - 3 * b >= 0 - 1000";
+    assert_(check(sum, "{x:bool | Prob(x) >= 7/10}", options), "Prob(x) >= 7/10 over a million values");
+    assert_(!check(sum, "{x:bool | Prob(x) >= 4/5}", options), "not Prob(x) >= 4/5 over a million values");
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    assert_(elapsed < std::chrono::seconds(10), "wide ranges are checked within 10 seconds");
+}
+
+// 0 -a-> 1 -> 0 is an end component, 0 -b-> {2 (target), 3} with 1/2 each
+PML_TEST(interval_iteration_test) {
+    mdp::explicit_mdp_t model;
+    model.states = {{0}, {1}, {2}, {3}};
+    model.choice_begin = {0, 2, 3, 4, 5};
+    model.transition_begin = {0, 1, 3, 4, 5, 6};
+    model.successors = {1, 2, 3, 0, 2, 3};
+    model.probs = {1.0, 0.5, 0.5, 1.0, 1.0, 1.0};
+    std::vector<bool> target{false, false, true, false};
+
+    auto mecs = checker::maximal_end_components(model, std::vector<bool>{true, true, false, false});
+    assert_eq(mecs.components.size(), 1u);
+    assert_eq(mecs.components[0].size(), 2u);
+
+    checker::options_t options;
+    auto bounds = checker::reach_bounds(model, target, checker::objective_t::Max, options);
+    assert_(bounds.lower[0] <= 0.5 && 0.5 <= bounds.upper[0], "bounds enclose Pmax");
+    assert_(bounds.upper[0] - bounds.lower[0] < options.precision, "bounds converged");
+
+    options.precision = 0;
+    options.max_iterations = 100;
+    checker::threshold_t threshold{checker::comparison_t::Lt, checker::rational_t{9} / 10};
+    auto early = checker::reach_bounds(model, target, checker::objective_t::Max, options, threshold);
+    assert_(early.upper[0] < 0.9, "stopped once the threshold was decided");
+
+    // value iteration only has a lower bound to decide with
+    options.iteration = checker::iteration_t::Value;
+    threshold = checker::threshold_t{checker::comparison_t::Geq, checker::rational_t{1} / 4};
+    auto lower = checker::reach_bounds(model, target, checker::objective_t::Max, options, threshold);
+    assert_(lower.lower[0] >= 0.25, "lower bound passed the threshold");
+    assert_eq(lower.upper[0], 1.0);
+}
+
 void test::run(int, const char**) {
     std::cerr << "\033[32m    <<<< language feature test >>>> \033[39m" << std::endl;
     arith_test{};
@@ -484,6 +1171,14 @@ void test::run(int, const char**) {
     std::cerr << "\033[32m    <<<< MDP transion test >>>> \033[39m" << std::endl;
     translation_test{};
     translation_rand_test{};
+    command_index_test{};
+    chain_fusion_test{};
+    wide_rand_test{};
+    rand_abstraction_test{};
+    dead_variable_test{};
+    merge_test{};
+    concurrent_translation_test{};
+    determinism_test{};
 
     std::cerr << "\033[32m    <<<< parsing test >>>> \033[39m" << std::endl;
     parsing_formula_test{};
@@ -501,6 +1196,23 @@ void test::run(int, const char**) {
     simple_type_let{};
     simple_type_rand{};
 
+    std::cerr << "\033[32m    <<<< model checking test >>>> \033[39m" << std::endl;
+    topological_sweep_test{};
+    precompute_test{};
+    scc_decomposition_test{};
+    interval_iteration_test{};
+    policy_iteration_test{};
+    bisimulation_test{};
+    exact_probability_test{};
+    on_the_fly_test{};
+    parallel_iteration_test{};
+    gauss_seidel_test{};
+    variable_order_test{};
+    symbolic_test{};
+    function_call_test{};
+    shared_formula_test{};
+    literal_test{};
+
     std::cerr << "\033[32m    <<<< typecheck test >>>> \033[39m" << std::endl;
     typecheck_test{};
 }
@@ -1,3 +1,12 @@
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <cctype>
+#include <functional>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "utility.hpp"
 #include "environment.hpp"
 #include "translate.hpp"
@@ -8,15 +17,26 @@ using mdp_t = mdp::mdp_t;
 
 using var_env_t = environment_t<value_info_t>;
 
-int translation_data::location_count = 0;
-int translation_data::var_count = 0;
+mdp_with_info_t trans_impl(translation_context_t&, ast::expr_t const&, var_env_t const&);
+mdp_with_info_t create_wide_rand_case(translation_context_t&, int start, int end);
+static std::vector<long long> digits_of(long long m);
 
-mdp_with_info_t trans_impl(ast::expr_t const&, var_env_t const&);
+// a `rand` is one command with a branch per value, which keeps the model
+// acyclic and open to `abstract_rand_branches`. Wider ranges are drawn
+// digit by digit when their size factors into digits of at most
+// `max_rand_branches`; other sizes stay one command up to
+// `max_rand_command` values, as only larger ones are worth the redraws
+// that make the model cyclic.
+static constexpr long long max_rand_branches = 1 << 12;
+static constexpr long long max_rand_command = 1 << 16;
 
-mdp_with_info_t create_rand_case(int start, int end) {
-    int from = translation_data::fresh_location();
-    int to = translation_data::fresh_location();
-    auto rand_var = translation_data::fresh_var();
+mdp_with_info_t create_rand_case(translation_context_t& context, int start, int end) {
+    long long n = (long long)end - start + 1;
+    if (n > max_rand_branches && (n > max_rand_command || !digits_of(n).empty()))
+        return create_wide_rand_case(context, start, end);
+    int from = context.fresh_location();
+    int to = context.fresh_location();
+    auto rand_var = context.fresh_var();
 
     mdp::command_t command {
         make<mdp::binop_expr_t>(
@@ -129,7 +149,173 @@ mdp::command_t make_concat_with_cond(int from, int to, ptr<mdp::expr_t> const& u
     };
 }
 
+// a translation without commands starts and accepts at the next fresh
+// location, where whatever follows it begins; allocates that location
+// when something else has to follow instead
+static void reserve_accept(translation_context_t& context, mdp_with_info_t const& m) {
+    if (m.accept == context.current_location())
+        context.fresh_location();
+}
+
+// `(x'=e)&(y'=f)&...` as (x, e), (y, f), ...
+using assignments_t = std::vector<std::pair<std::string, ptr<mdp::expr_t>>>;
+
+static void split_update(mdp::expr_t const& update, assignments_t& out) {
+    auto const& binop = mdp::cast<mdp::binop_expr_t>(update);
+    if (binop.binop_kind == mdp::binop_kind_t::And) {
+        split_update(*binop.lhs, out);
+        split_update(*binop.rhs, out);
+        return;
+    }
+    auto name = mdp::cast<mdp::var_expr_t>(*binop.lhs).name;
+    name.pop_back(); // '
+    out.emplace_back(name, binop.rhs);
+}
+
+static ptr<mdp::expr_t> join_update(assignments_t const& assignments) {
+    ptr<mdp::expr_t> result;
+    for (auto const& assignment : assignments) {
+        auto eq = make<mdp::binop_expr_t>(
+                make<mdp::var_expr_t>(assignment.first + "'"),
+                assignment.second,
+                mdp::binop_kind_t::Eq);
+        result = result ? make<mdp::binop_expr_t>(result, eq, mdp::binop_kind_t::And) : eq;
+    }
+    return result;
+}
+
+static int target_location(assignments_t const& assignments) {
+    for (auto const& assignment : assignments) {
+        if (assignment.first == "location")
+            return mdp::cast<mdp::int_expr_t>(*assignment.second).n;
+    }
+    throw std::logic_error{"update without location"};
+}
+
+// the prime factors of `m` packed into digits of at most
+// `max_rand_branches` values; empty if a prime factor is larger
+static std::vector<long long> digits_of(long long m) {
+    std::vector<long long> factors;
+    for (long long p=2; p*p<=m; ++p) {
+        while (m % p == 0) {
+            factors.push_back(p);
+            m /= p;
+        }
+    }
+    if (m > 1)
+        factors.push_back(m);
+    if (factors.back() > max_rand_branches)
+        return {};
+    std::sort(factors.rbegin(), factors.rend());
+    std::vector<long long> digits;
+    for (auto p : factors) {
+        auto fits = std::find_if(digits.begin(), digits.end(),
+                [&](long long d) { return d * p <= max_rand_branches; });
+        if (fits != digits.end())
+            *fits *= p;
+        else
+            digits.push_back(p);
+    }
+    return digits;
+}
+
+// `var` is set to `start` plus the digit times `scale`, or increased by
+// it if there is no `start`
+mdp::command_t make_draw(
+        int from, int to, std::string const& var,
+        long long count, util::optional<int> start, long long scale) {
+    mdp::command_t command {
+        make<mdp::binop_expr_t>(
+                make<mdp::var_expr_t>("location"),
+                make<mdp::int_expr_t>(from),
+                mdp::binop_kind_t::Eq),
+        {}
+    };
+    auto prob = make<mdp::binop_expr_t>(
+            make<mdp::int_expr_t>(1),
+            make<mdp::int_expr_t>((int)count),
+            mdp::binop_kind_t::Div);
+    auto next = make<mdp::binop_expr_t>(
+            make<mdp::var_expr_t>("location'"),
+            make<mdp::int_expr_t>(to),
+            mdp::binop_kind_t::Eq);
+    for (long long d=0; d<count; ++d) {
+        ptr<mdp::expr_t> value = start ?
+            ptr<mdp::expr_t>{make<mdp::int_expr_t>((int)(*start + d * scale))} :
+            ptr<mdp::expr_t>{make<mdp::binop_expr_t>(
+                    make<mdp::var_expr_t>(var),
+                    make<mdp::int_expr_t>((int)(d * scale)),
+                    mdp::binop_kind_t::Add)};
+        command.branches.push_back(mdp::branch_t{prob, make<mdp::binop_expr_t>(
+                    next,
+                    make<mdp::binop_expr_t>(make<mdp::var_expr_t>(var + "'"), value, mdp::binop_kind_t::Eq),
+                    mdp::binop_kind_t::And)});
+    }
+    return command;
+}
+
+// draws a uniform number below `m` as independent digits in mixed radix,
+// where `m` is the least number from `end-start+1` on whose digits fit in
+// `max_rand_branches`; draws beyond `end` start over
+mdp_with_info_t create_wide_rand_case(translation_context_t& context, int start, int end) {
+    long long n = (long long)end - start + 1;
+    long long m = n;
+    auto digits = digits_of(m);
+    while (digits.empty())
+        digits = digits_of(++m);
+
+    int from = context.fresh_location();
+    std::vector<int> steps{from};
+    for (size_t i=1; i<digits.size(); ++i)
+        steps.push_back(context.fresh_location());
+    int check = m > n ? context.fresh_location() : -1;
+    int to = context.fresh_location();
+    auto rand_var = context.fresh_var();
+
+    std::vector<mdp::command_t> commands;
+    long long scale = 1;
+    for (size_t i=0; i<digits.size(); ++i) {
+        int next = i + 1 < digits.size() ? steps[i + 1] : m > n ? check : to;
+        commands.push_back(make_draw(
+                    steps[i], next, rand_var, digits[i],
+                    i == 0 ? util::optional<int>{start} : util::nullopt, scale));
+        scale *= digits[i];
+    }
+    if (m > n) {
+        auto in_range = make<mdp::binop_expr_t>(
+                make<mdp::var_expr_t>(rand_var),
+                make<mdp::int_expr_t>(end),
+                mdp::binop_kind_t::Leq);
+        commands.push_back(make_concat_with_cond(check, to, in_range));
+        commands.push_back(make_concat_with_cond(check, from, make<mdp::neg_expr_t>(in_range)));
+    }
+
+    mdp::mdp_t mdp {
+        "default",
+        {
+            mdp::variable_t {
+                "location",
+                bound_t{from, to}, from
+            },
+            mdp::variable_t {
+                rand_var,
+                bound_t{start, (int)(start + m - 1)}, start
+            }
+        },
+        {}, // constants
+        std::move(commands)
+    };
+
+    return mdp_with_info_t {
+        std::move(mdp), from, to,
+        value_info_t {
+            rand_var, {bound_t{start, end}}
+        }
+    };
+}
+
 mdp_with_info_t create_let_case(
+        translation_context_t& context,
         std::string const& name,
         ast::expr_t const& init,
         ast::expr_t const& body,
@@ -138,9 +324,10 @@ mdp_with_info_t create_let_case(
     // TODO: resolve name conflict case
     // e.g) let a = 1 in let a = 3 in ...
 
-    auto init_ = trans_impl(init, var_env);
-    auto new_env = var_env.append(name, make<value_info_t>(init_.value));
-    auto body_ = trans_impl(body, new_env);
+    auto init_ = trans_impl(context, init, var_env);
+    reserve_accept(context, init_);
+    auto new_env = var_env.append(name, make<value_info_t>(value_info_t{name, init_.value.bound}));
+    auto body_ = trans_impl(context, body, new_env);
 
     // concat accept location of init to init location of body,
     // and subst value of init to variable `name`.
@@ -150,7 +337,7 @@ mdp_with_info_t create_let_case(
             init_.accept, body_.init,
             make<mdp::binop_expr_t>(
                 make<mdp::var_expr_t>(name+"'"),
-                make<mdp::var_expr_t>(init_.value.name),
+                init_.value.expr(),
                 mdp::binop_kind_t::Eq));
 
     auto result_mdp = mdp::mdp_t::merge(std::move(init_.mdp), std::move(body_.mdp));
@@ -158,7 +345,7 @@ mdp_with_info_t create_let_case(
 
     if (init_.value.bound) { // integer
         result_mdp.variables.push_back(mdp::variable_t {
-                name, *init_.value.bound, 0
+                name, *init_.value.bound, init_.value.bound->min
                 });
     } else { // boolean
         result_mdp.variables.push_back(mdp::variable_t {
@@ -167,19 +354,23 @@ mdp_with_info_t create_let_case(
     }
 
     return mdp_with_info_t {
-        result_mdp, init_.init, body_.accept,
+        std::move(result_mdp), init_.init, body_.accept,
         body_.value
     };
 }
 
 mdp_with_info_t create_if_case(
+        translation_context_t& context,
         ast::expr_t const& cond,
         ast::expr_t const& tr, ast::expr_t const& fl,
         var_env_t const& var_env) {
 
-    auto cond_ = trans_impl(cond, var_env);
-    auto tr_ = trans_impl(tr, var_env);
-    auto fl_ = trans_impl(fl, var_env);
+    auto cond_ = trans_impl(context, cond, var_env);
+    reserve_accept(context, cond_);
+    auto tr_ = trans_impl(context, tr, var_env);
+    reserve_accept(context, tr_);
+    auto fl_ = trans_impl(context, fl, var_env);
+    reserve_accept(context, fl_);
 
     auto result_mdp = mdp::mdp_t::merge(
             mdp::mdp_t::merge(std::move(cond_.mdp), std::move(tr_.mdp)),
@@ -188,27 +379,27 @@ mdp_with_info_t create_if_case(
     // [] location=accept-of-cond & cond -> 1:location'=init-of-tr
     auto concat_to_true = make_concat_with_cond(
             cond_.accept, tr_.init,
-            make<mdp::var_expr_t>(cond_.value.name));
+            cond_.value.expr());
     // [] location=accept-of-cond & !cond -> 1:location'=init-of-fl
-    auto concat_to_false = make_concat(
+    auto concat_to_false = make_concat_with_cond(
             cond_.accept, fl_.init,
-            make<mdp::neg_expr_t>(make<mdp::var_expr_t>(cond_.value.name)));
+            make<mdp::neg_expr_t>(cond_.value.expr()));
 
-    auto accept_loc = translation_data::fresh_location();
-    auto result_var_name = translation_data::fresh_var();
+    auto accept_loc = context.fresh_location();
+    auto result_var_name = context.fresh_var();
     // [] location=accept-of-tr -> 1:location'=accept & value_name'=value_name-of-tr
     auto phi_true = make_concat(
             tr_.accept, accept_loc,
             make<mdp::binop_expr_t>(
                 make<mdp::var_expr_t>(result_var_name + "'"),
-                make<mdp::var_expr_t>(tr_.value.name),
+                tr_.value.expr(),
                 mdp::binop_kind_t::Eq));
     // [] location=accept-of-fl -> 1:location'=accept & value_name'=value_name-of-fl
     auto phi_false = make_concat(
             fl_.accept, accept_loc,
             make<mdp::binop_expr_t>(
                 make<mdp::var_expr_t>(result_var_name+"'"),
-                make<mdp::var_expr_t>(fl_.value.name),
+                fl_.value.expr(),
                 mdp::binop_kind_t::Eq));
 
     result_mdp.commands.push_back(concat_to_true);
@@ -220,13 +411,14 @@ mdp_with_info_t create_if_case(
         throw std::logic_error{"invalid if expression"};
 
     auto result_var = tr_.value.bound ?
-        mdp::variable_t{result_var_name, *tr_.value.bound | *fl_.value.bound, 0} :
+        mdp::variable_t{result_var_name, *tr_.value.bound | *fl_.value.bound,
+            std::min(tr_.value.bound->min, fl_.value.bound->min)} :
         mdp::variable_t{result_var_name, true};
 
     result_mdp.variables.push_back(result_var);
 
     return mdp_with_info_t {
-        result_mdp, cond_.init, accept_loc,
+        std::move(result_mdp), cond_.init, accept_loc,
         value_info_t {
             result_var_name,
             result_var.is_int() ?
@@ -236,92 +428,85 @@ mdp_with_info_t create_if_case(
     };
 }
 
-value_info_t calc_binop_bound(
-        value_info_t const& lhs,
-        value_info_t const& rhs,
+struct binop_info_t {
+    mdp::binop_kind_t kind;
+    util::optional<bound_t> bound; // nullopt for booleans
+};
+
+// `lhs` and `rhs` are the bounds of integer operands
+binop_info_t calc_binop_bound(
+        util::optional<bound_t> const& lhs,
+        util::optional<bound_t> const& rhs,
         ast::expr_kind_t op) {
+    using mdp::binop_kind_t;
     switch (op) {
     case ast::expr_kind_t::Add:
-        return value_info_t {
-            format("({}+{})", lhs.name, rhs.name),
-            *lhs.bound + *rhs.bound
-        };
+        return binop_info_t{binop_kind_t::Add, *lhs + *rhs};
     case ast::expr_kind_t::Sub:
-        return value_info_t {
-            format("({}-{})", lhs.name, rhs.name),
-            *lhs.bound - *rhs.bound
-        };
+        return binop_info_t{binop_kind_t::Sub, *lhs - *rhs};
     case ast::expr_kind_t::Mul:
-        return value_info_t {
-            format("({}*{})", lhs.name, rhs.name),
-            *lhs.bound * *rhs.bound
-        };
+        return binop_info_t{binop_kind_t::Mul, *lhs * *rhs};
     case ast::expr_kind_t::Div:
-        return value_info_t {
-            format("({}/{})", lhs.name, rhs.name),
-            *lhs.bound / *rhs.bound
-        };
+        return binop_info_t{binop_kind_t::Div, *lhs / *rhs};
     case ast::expr_kind_t::Eq:
-        return value_info_t {
-            format("{}={}", lhs.name, rhs.name),
-            util::nullopt
-        };
+        return binop_info_t{binop_kind_t::Eq, util::nullopt};
     case ast::expr_kind_t::Neq:
-        return value_info_t {
-            format("({}!={})", lhs.name, rhs.name),
-            util::nullopt
-        };
+        return binop_info_t{binop_kind_t::Neq, util::nullopt};
     case ast::expr_kind_t::Leq:
-        return value_info_t {
-            format("({}<={})", lhs.name, rhs.name),
-            util::nullopt
-        };
+        return binop_info_t{binop_kind_t::Leq, util::nullopt};
     case ast::expr_kind_t::Geq:
-        return value_info_t {
-            format("({}>={})", lhs.name, rhs.name),
-            util::nullopt
-        };
+        return binop_info_t{binop_kind_t::Geq, util::nullopt};
     case ast::expr_kind_t::And:
-        return value_info_t {
-            format("({}&{})", lhs.name, rhs.name),
-            util::nullopt
-        };
+        return binop_info_t{binop_kind_t::And, util::nullopt};
     case ast::expr_kind_t::Or:
-        return value_info_t {
-            format("({}|{})", lhs.name, rhs.name),
-            util::nullopt
-        };
+        return binop_info_t{binop_kind_t::Or, util::nullopt};
     default:
         throw std::logic_error{"invalid binop"};
     }
 }
 
 mdp_with_info_t create_binop_case(
+        translation_context_t& context,
         ast::expr_t const& lhs_expr,
         ast::expr_t const& rhs_expr,
         ast::expr_kind_t op,
         var_env_t const& var_env) {
-    auto lhs_ = trans_impl(lhs_expr, var_env);
+    auto lhs_ = trans_impl(context, lhs_expr, var_env);
     auto const& lhs = lhs_.value;
-    auto rhs_ = trans_impl(rhs_expr, var_env);
+    auto rhs_ = trans_impl(context, rhs_expr, var_env);
     auto const& rhs = rhs_.value;
 
     auto result_mdp = mdp::mdp_t::merge(
             std::move(lhs_.mdp),
             std::move(rhs_.mdp));
+    // [] location=accept-of-lhs -> 1:location'=init-of-rhs
+    if (lhs_.accept != rhs_.init)
+        result_mdp.commands.push_back(make_concat(lhs_.accept, rhs_.init));
 
-    auto result_bound = calc_binop_bound(lhs, rhs, op);
+    // the value is a formula over the names of both operands, so nested
+    // arithmetic is written once, operator by operator
+    auto binop = calc_binop_bound(lhs.bound, rhs.bound, op);
+    auto name = context.fresh_formula();
+    result_mdp.formulas.push_back(mdp::formula_t{
+            name,
+            make<mdp::binop_expr_t>(
+                lhs.expr(),
+                rhs.expr(),
+                binop.kind)});
 
     return mdp_with_info_t {
-        result_mdp, lhs_.init, rhs_.accept,
-        result_bound
+        std::move(result_mdp), lhs_.init, rhs_.accept,
+        value_info_t {
+            name, binop.bound
+        }
     };
 }
 
-mdp_with_info_t create_neg_case(ast::expr_t const& inner, var_env_t const& var_env) {
-    auto inner_ = trans_impl(inner, var_env);
-    auto accept_loc = translation_data::fresh_location();
-    auto result_var_name = translation_data::fresh_var();
+mdp_with_info_t create_neg_case(translation_context_t& context, ast::expr_t const& inner, var_env_t const& var_env) {
+    auto inner_ = trans_impl(context, inner, var_env);
+    reserve_accept(context, inner_);
+    auto accept_loc = context.fresh_location();
+    auto result_var_name = context.fresh_var();
 
     auto result_var = mdp::variable_t{result_var_name, true};
 
@@ -331,58 +516,50 @@ mdp_with_info_t create_neg_case(ast::expr_t const& inner, var_env_t const& var_e
             make<mdp::binop_expr_t>(
                 make<mdp::var_expr_t>(result_var_name+"'"),
                 make<mdp::neg_expr_t>(
-                    make<mdp::var_expr_t>(inner_.value.name)),
+                    inner_.value.expr()),
                 mdp::binop_kind_t::Eq));
 
     inner_.mdp.commands.push_back(concat);
     inner_.mdp.variables.push_back(result_var);
 
     return mdp_with_info_t {
-        inner_.mdp, inner_.init, accept_loc,
+        std::move(inner_.mdp), inner_.init, accept_loc,
         value_info_t {
             result_var_name, util::nullopt
         }
     };
 }
 
-mdp_with_info_t create_int_case(int n) {
-    auto const_name = "c" + std::to_string(n);
-    int current = translation_data::current_location();
+// literals are inlined rather than declared as constants
+mdp_with_info_t create_int_case(translation_context_t const& context, int n) {
+    int current = context.current_location();
     return mdp_with_info_t {
         mdp::mdp_t {
-            "default",
-            {},
-            { mdp::constant_t{const_name, n} },
-            {}
+            "default", {}, {}, {}
         },
         current, current,
         value_info_t {
-            const_name, {bound_t{n, n}}
+            "", {bound_t{n, n}}, make<mdp::int_expr_t>(n)
         }
     };
 }
 
-mdp_with_info_t create_bool_case(bool b) {
-    auto const_name = "c" + std::to_string(b);
-    int current = translation_data::current_location();
+mdp_with_info_t create_bool_case(translation_context_t const& context, bool b) {
+    int current = context.current_location();
     return mdp_with_info_t {
         mdp::mdp_t {
-            "default",
-            {},
-            { mdp::constant_t{const_name, b} },
-            {}
+            "default", {}, {}, {}
         },
         current, current,
         value_info_t {
-            const_name, util::nullopt
+            "", util::nullopt, make<mdp::bool_expr_t>(b)
         }
     };
 }
 
-mdp_with_info_t create_var_case(std::string const& name, var_env_t const& var_env) {
+mdp_with_info_t create_var_case(translation_context_t const& context, std::string const& name, var_env_t const& var_env) {
     auto result_var = *var_env.lookup(name);
-    result_var.name = name;
-    int current = translation_data::current_location();
+    int current = context.current_location();
     return mdp_with_info_t {
         mdp::mdp_t {
             "default", {}, {}, {}
@@ -392,23 +569,647 @@ mdp_with_info_t create_var_case(std::string const& name, var_env_t const& var_en
     };
 }
 
-mdp_with_info_t trans_impl(ast::expr_t const& e, var_env_t const& var_env) {
+// A `letfun` is translated once. A call stores its arguments in the
+// parameters and its site in `_<f>_ret`, and jumps to the entry of the
+// body; the accept location of the body returns to the site. A call from
+// within the body first pushes the frame, i.e. every variable of the
+// body, onto a stack of `depth - 1` saved frames kept in `_<var>_<f><i>`,
+// and ends in the overflow location once it is full, where the value is
+// unknown: properties count such a run against them. A call in tail
+// position neither pushes nor returns, so a function called again with
+// the same arguments is in the same state however deep it recursed.
+
+struct call_site_t {
+    int call, after;
+    std::vector<ptr<mdp::expr_t>> args;
+    std::string result;
+    bool recursive;
+    bool tail;
+};
+
+struct function_info_t {
+    std::string name;
+    // nullopt for booleans
+    std::vector<util::optional<bound_t>> params;
+    util::optional<bound_t> ret;
+    // argument bounds of the calls met by `bound_of`
+    std::vector<util::optional<bound_t>> seen;
+    // argument bounds of the calls from outside of the body
+    std::vector<util::optional<bound_t>> outer;
+    int depth = 0;
+    bool derived = false; // `depth` comes from the arguments, not `max_depth`
+    std::unordered_set<ast::app_expr_t const*> tail_calls;
+    int entry = 0;
+    bool in_body = false;
+    std::vector<call_site_t> sites;
+};
+
+using functions_t = std::vector<function_info_t*>;
+
+static function_info_t& function_of(functions_t const& functions, ast::expr_t const& f) {
+    if (f.kind() == ast::expr_kind_t::Var) {
+        auto const& name = ast::cast<ast::var_expr_t>(f).name;
+        for (auto it = functions.rbegin(); it != functions.rend(); ++it) {
+            if ((*it)->name == name)
+                return **it;
+        }
+    }
+    throw std::logic_error{"only functions bound by letfun can be applied"};
+}
+
+// nullopt is the empty bound
+static util::optional<bound_t> join(util::optional<bound_t> const& lhs, util::optional<bound_t> const& rhs) {
+    if (!lhs)
+        return rhs;
+    if (!rhs)
+        return lhs;
+    return *lhs | *rhs;
+}
+
+static bool same_bound(util::optional<bound_t> const& lhs, util::optional<bound_t> const& rhs) {
+    if (!lhs || !rhs)
+        return !lhs && !rhs;
+    return lhs->min == rhs->min && lhs->max == rhs->max;
+}
+
+static void analyze(translation_context_t&, function_info_t&, ast::letfun_expr_t const&, var_env_t const&);
+
+// the bound `trans_impl` gives the value of `e`, without translating it;
+// nullopt for booleans and for results of functions that are not known
+// yet. Calls widen the `seen` bounds of their function.
+static util::optional<bound_t> bound_of(translation_context_t& context, ast::expr_t const& e, var_env_t const& var_env) {
+    using namespace ast;
+    auto& functions = context.functions;
+    switch (e.kind()) {
+    case expr_kind_t::Let: {
+        auto const& let = cast<let_expr_t>(e);
+        auto init = bound_of(context, *let.init, var_env);
+        auto new_env = var_env.append(let.name, make<value_info_t>(value_info_t{let.name, init}));
+        return bound_of(context, *let.body, new_env);
+        }
+    case expr_kind_t::LetFun: {
+        auto const& letfun = cast<letfun_expr_t>(e);
+        function_info_t info;
+        analyze(context, info, letfun, var_env);
+        functions.push_back(&info);
+        auto result = bound_of(context, *letfun.body, var_env);
+        functions.pop_back();
+        return result;
+        }
+    case expr_kind_t::If:
+        bound_of(context, *cast<if_expr_t>(e).cond_expr, var_env);
+        return join(
+                bound_of(context, *cast<if_expr_t>(e).true_expr, var_env),
+                bound_of(context, *cast<if_expr_t>(e).false_expr, var_env));
+    case expr_kind_t::App: {
+        auto const& app = cast<app_expr_t>(e);
+        auto& f = function_of(functions, *app.f);
+        if (app.args.size() != f.params.size())
+            throw std::logic_error{"partial application of " + f.name};
+        for (size_t i=0; i<app.args.size(); ++i)
+            f.seen[i] = join(f.seen[i], bound_of(context, *app.args[i], var_env));
+        return f.ret;
+        }
+    case expr_kind_t::Rand:
+        return bound_t{cast<rand_expr_t>(e).start, cast<rand_expr_t>(e).end};
+    case expr_kind_t::Add: case expr_kind_t::Sub:
+    case expr_kind_t::Mul: case expr_kind_t::Div:
+    case expr_kind_t::Eq:  case expr_kind_t::Neq:
+    case expr_kind_t::Leq: case expr_kind_t::Geq:
+    case expr_kind_t::And: case expr_kind_t::Or: {
+        auto lhs = bound_of(context, *cast<binop_expr_t>(e).lhs, var_env);
+        auto rhs = bound_of(context, *cast<binop_expr_t>(e).rhs, var_env);
+        if (!lhs || !rhs)
+            return util::nullopt;
+        return calc_binop_bound(lhs, rhs, e.kind()).bound;
+        }
+    case expr_kind_t::Neg:
+        bound_of(context, *cast<neg_expr_t>(e).inner, var_env);
+        return util::nullopt;
+    case expr_kind_t::Int:
+        return bound_t{cast<int_expr_t>(e).n, cast<int_expr_t>(e).n};
+    case expr_kind_t::Bool:
+        return util::nullopt;
+    case expr_kind_t::Var:
+        return var_env.lookup(cast<var_expr_t>(e).name)->bound;
+    case expr_kind_t::Typed:
+        return bound_of(context, *cast<typed_expr_t>(e).expr, var_env);
+    default:
+        throw std::logic_error{"unimplemented translation"};
+    }
+}
+
+// bounds of the parameters and the result of `letfun` from its calls in
+// both its body and the expression it scopes. Iteration starts from
+// empty bounds and runs once per frame of a stack of `depth`, which
+// covers the values of every call the stack does not overflow on.
+static void summarize(
+        translation_context_t& context,
+        function_info_t& info,
+        ast::letfun_expr_t const& letfun,
+        var_env_t const& var_env,
+        int depth) {
+    auto const& args = letfun.type.args;
+    auto& functions = context.functions;
+    info.name = letfun.name;
+    info.params.assign(args.size(), util::nullopt);
+    info.ret = util::nullopt;
+
+    functions.push_back(&info);
+    for (int round=0; round<=depth; ++round) {
+        info.seen.assign(args.size(), util::nullopt);
+        bound_of(context, *letfun.body, var_env);
+        info.outer = info.seen;
+        auto body_env = var_env;
+        for (size_t i=0; i<args.size(); ++i) {
+            body_env = body_env.append(
+                    args[i].name,
+                    make<value_info_t>(value_info_t{args[i].name, info.params[i]}));
+        }
+        auto ret = join(info.ret, bound_of(context, *letfun.init, body_env));
+
+        bool changed = !same_bound(ret, info.ret);
+        info.ret = ret;
+        for (size_t i=0; i<args.size(); ++i) {
+            auto param = join(info.params[i], info.seen[i]);
+            changed = changed || !same_bound(param, info.params[i]);
+            info.params[i] = param;
+        }
+        if (!changed)
+            break;
+    }
+    functions.pop_back();
+
+    // never called, or never returning
+    for (size_t i=0; i<args.size(); ++i) {
+        if (args[i].domain == logic::domain_kind_t::Int && !info.params[i])
+            info.params[i] = bound_t{0, 0};
+    }
+    if (letfun.type.ret_type.domain == logic::domain_kind_t::Int && !info.ret)
+        info.ret = bound_t{0, 0};
+}
+
+using guards_t = std::vector<std::pair<ast::expr_t const*, bool>>;
+
+struct recursive_call_t {
+    ast::app_expr_t const* app;
+    bool tail; // its result is the result of the body
+    bool exact; // not in a nested function, nor where a parameter is shadowed
+    guards_t guards; // conditions of the enclosing `if`s, and the branch taken
+};
+
+static void find_calls(
+        ast::letfun_expr_t const& letfun,
+        ast::expr_t const& e,
+        bool tail, bool exact,
+        guards_t& guards,
+        std::vector<recursive_call_t>& calls) {
+    using namespace ast;
+    auto shadows = [&](std::string const& name) {
+        return std::any_of(letfun.type.args.begin(), letfun.type.args.end(),
+                [&](refinement_type_t const& arg) { return arg.name == name; });
+    };
+    auto walk = [&](expr_t const& sub, bool sub_tail, bool sub_exact) {
+        find_calls(letfun, sub, sub_tail, sub_exact, guards, calls);
+    };
+    switch (e.kind()) {
+    case expr_kind_t::Let: {
+        auto const& let = cast<let_expr_t>(e);
+        walk(*let.init, false, exact);
+        if (let.name != letfun.name)
+            walk(*let.body, tail, exact && !shadows(let.name));
+        break;
+        }
+    case expr_kind_t::LetFun: {
+        auto const& inner = cast<letfun_expr_t>(e);
+        if (inner.name == letfun.name)
+            break;
+        walk(*inner.init, false, false);
+        walk(*inner.body, tail, exact);
+        break;
+        }
+    case expr_kind_t::If: {
+        auto const& if_ = cast<if_expr_t>(e);
+        walk(*if_.cond_expr, false, exact);
+        guards.emplace_back(if_.cond_expr.get(), true);
+        walk(*if_.true_expr, tail, exact);
+        guards.back().second = false;
+        walk(*if_.false_expr, tail, exact);
+        guards.pop_back();
+        break;
+        }
+    case expr_kind_t::App: {
+        auto const& app = cast<app_expr_t>(e);
+        for (auto const& arg : app.args)
+            walk(*arg, false, exact);
+        if (app.f->kind() == expr_kind_t::Var && cast<var_expr_t>(*app.f).name == letfun.name)
+            calls.push_back(recursive_call_t{&app, tail, exact, guards});
+        break;
+        }
+    case expr_kind_t::Add: case expr_kind_t::Sub:
+    case expr_kind_t::Mul: case expr_kind_t::Div:
+    case expr_kind_t::Eq:  case expr_kind_t::Neq:
+    case expr_kind_t::Leq: case expr_kind_t::Geq:
+    case expr_kind_t::And: case expr_kind_t::Or:
+        walk(*cast<binop_expr_t>(e).lhs, false, exact);
+        walk(*cast<binop_expr_t>(e).rhs, false, exact);
+        break;
+    case expr_kind_t::Neg:
+        walk(*cast<neg_expr_t>(e).inner, false, exact);
+        break;
+    case expr_kind_t::Typed:
+        walk(*cast<typed_expr_t>(e).expr, tail, exact);
+        break;
+    default:
+        break;
+    }
+}
+
+static util::optional<int> greater(util::optional<int> const& lhs, util::optional<int> const& rhs) {
+    if (!lhs || !rhs)
+        return lhs ? lhs : rhs;
+    return std::max(*lhs, *rhs);
+}
+
+// the least value of `param` wherever `cond` evaluates to `holds`; an
+// inequality to a constant `c` counts as `param > c` when `param` only
+// goes down by one from `start` or above
+static util::optional<int> lower_bound_of(
+        std::string const& param,
+        ast::expr_t const& cond, bool holds,
+        util::optional<int> const& start) {
+    using namespace ast;
+    auto is_param = [&](expr_t const& e) {
+        return e.kind() == expr_kind_t::Var && cast<var_expr_t>(e).name == param;
+    };
+    switch (cond.kind()) {
+    case expr_kind_t::Neg:
+        return lower_bound_of(param, *cast<neg_expr_t>(cond).inner, !holds, start);
+    case expr_kind_t::And: case expr_kind_t::Or: {
+        // both sides have the value of the whole one way
+        if (holds != (cond.kind() == expr_kind_t::And))
+            return util::nullopt;
+        auto const& binop = cast<binop_expr_t>(cond);
+        return greater(
+                lower_bound_of(param, *binop.lhs, holds, start),
+                lower_bound_of(param, *binop.rhs, holds, start));
+        }
+    case expr_kind_t::Leq: case expr_kind_t::Geq: {
+        // small <= big
+        auto const& binop = cast<binop_expr_t>(cond);
+        bool leq = cond.kind() == expr_kind_t::Leq;
+        auto const& small = leq ? *binop.lhs : *binop.rhs;
+        auto const& big = leq ? *binop.rhs : *binop.lhs;
+        if (holds && is_param(big) && small.kind() == expr_kind_t::Int)
+            return cast<int_expr_t>(small).n;
+        if (!holds && is_param(small) && big.kind() == expr_kind_t::Int)
+            return cast<int_expr_t>(big).n + 1;
+        return util::nullopt;
+        }
+    case expr_kind_t::Eq: case expr_kind_t::Neq: {
+        auto const& binop = cast<binop_expr_t>(cond);
+        if (holds != (cond.kind() == expr_kind_t::Neq))
+            return util::nullopt;
+        auto const& constant = is_param(*binop.lhs) ? *binop.rhs : *binop.lhs;
+        if (!is_param(*binop.lhs) && !is_param(*binop.rhs))
+            return util::nullopt;
+        if (!start || constant.kind() != expr_kind_t::Int || *start < cast<int_expr_t>(constant).n)
+            return util::nullopt;
+        return cast<int_expr_t>(constant).n + 1;
+        }
+    default:
+        return util::nullopt;
+    }
+}
+
+// `k` for an argument `param - k` with a positive `k`
+static util::optional<int> decrement_of(std::string const& param, ast::expr_t const& arg) {
+    using namespace ast;
+    if (arg.kind() != expr_kind_t::Sub)
+        return util::nullopt;
+    auto const& binop = cast<binop_expr_t>(arg);
+    if (binop.lhs->kind() != expr_kind_t::Var || cast<var_expr_t>(*binop.lhs).name != param ||
+        binop.rhs->kind() != expr_kind_t::Int || cast<int_expr_t>(*binop.rhs).n <= 0)
+        return util::nullopt;
+    return cast<int_expr_t>(*binop.rhs).n;
+}
+
+struct recursion_t {
+    int depth; // of a stack no call overflows
+    int activations; // nested in the longest chain of calls
+};
+
+// how deep `letfun` recurses, when an int parameter decreases on every
+// recursive call and each call is only made above a constant; a chain of
+// activations then calls at most once per value between that constant
+// and the largest argument from outside
+static util::optional<recursion_t> bounded_recursion(
+        ast::letfun_expr_t const& letfun,
+        function_info_t const& info,
+        std::vector<recursive_call_t> const& calls) {
+    auto const& args = letfun.type.args;
+    util::optional<recursion_t> result;
+    for (size_t i=0; i<args.size(); ++i) {
+        if (!info.outer[i])
+            continue;
+        std::vector<int> steps;
+        for (auto const& call : calls) {
+            auto k = call.exact && call.app->args.size() == args.size() ?
+                decrement_of(args[i].name, *call.app->args[i]) :
+                util::nullopt;
+            if (!k)
+                break;
+            steps.push_back(*k);
+        }
+        if (steps.size() != calls.size())
+            continue;
+        int step = steps.empty() ? 1 : *std::min_element(steps.begin(), steps.end());
+        util::optional<int> start;
+        if (std::all_of(steps.begin(), steps.end(), [](int k) { return k == 1; }))
+            start = info.outer[i]->min;
+
+        // the least values of calls, and of calls that push a frame
+        util::optional<int> lowest, lowest_push;
+        bool guarded = true;
+        for (auto const& call : calls) {
+            util::optional<int> low;
+            for (auto const& guard : call.guards) {
+                low = greater(low, lower_bound_of(args[i].name, *guard.first, guard.second, start));
+            }
+            if (!low) {
+                guarded = false;
+                break;
+            }
+            lowest = lowest ? std::min(*lowest, *low) : *low;
+            if (!call.tail)
+                lowest_push = lowest_push ? std::min(*lowest_push, *low) : *low;
+        }
+        if (!guarded)
+            continue;
+        auto count = [&](util::optional<int> const& low) {
+            return low && info.outer[i]->max >= *low ? (info.outer[i]->max - *low) / step + 1 : 0;
+        };
+        // the stack still has room for one frame, which is never pushed
+        recursion_t recursion{std::max(count(lowest_push) + 1, 2), count(lowest) + 1};
+        if (!result || recursion.activations < result->activations)
+            result = recursion;
+    }
+    return result;
+}
+
+// bounds, stack depth and tail calls of `letfun`. Tail calls recurse
+// without a stack, so they are only made so when the recursion is
+// bounded, and the bounds of the parameters cover every activation.
+static void analyze(
+        translation_context_t& context,
+        function_info_t& info,
+        ast::letfun_expr_t const& letfun,
+        var_env_t const& var_env) {
+    std::vector<recursive_call_t> calls;
+    guards_t guards;
+    find_calls(letfun, *letfun.init, true, true, guards, calls);
+
+    summarize(context, info, letfun, var_env, context.max_depth);
+    auto recursion = bounded_recursion(letfun, info, calls);
+    if (recursion && recursion->activations > context.max_depth) {
+        // the arguments from outside may rise with the deeper bounds
+        summarize(context, info, letfun, var_env, recursion->activations);
+        auto again = bounded_recursion(letfun, info, calls);
+        if (!again || again->activations > recursion->activations) {
+            summarize(context, info, letfun, var_env, context.max_depth);
+            recursion = util::nullopt;
+        }
+    }
+    if (!recursion) {
+        info.depth = context.max_depth;
+        return;
+    }
+    info.depth = recursion->depth;
+    info.derived = true;
+    for (auto const& call : calls) {
+        if (call.tail)
+            info.tail_calls.insert(call.app);
+    }
+}
+
+static mdp::variable_t declare(std::string const& name, util::optional<bound_t> const& bound) {
+    return bound ?
+        mdp::variable_t{name, *bound, bound->min} :
+        mdp::variable_t{name, false};
+}
+
+// [] location=from & cond -> 1:update, where `update` moves `location`
+static mdp::command_t make_step(int from, ptr<mdp::expr_t> const& cond, assignments_t const& update) {
+    ptr<mdp::expr_t> guard = make<mdp::binop_expr_t>(
+            make<mdp::var_expr_t>("location"),
+            make<mdp::int_expr_t>(from),
+            mdp::binop_kind_t::Eq);
+    if (cond)
+        guard = make<mdp::binop_expr_t>(guard, cond, mdp::binop_kind_t::And);
+    return mdp::command_t {
+        guard,
+        { mdp::branch_t{make<mdp::int_expr_t>(1), join_update(update)} }
+    };
+}
+
+mdp_with_info_t create_app_case(translation_context_t& context, ast::app_expr_t const& app, var_env_t const& var_env) {
+    auto& f = function_of(context.functions, *app.f);
+    if (app.args.size() != f.params.size())
+        throw std::logic_error{"partial application of " + f.name};
+
+    // arguments are evaluated from left to right
+    int init = context.current_location();
+    int at = init;
+    mdp_t result_mdp{"default", {}, {}, {}};
+    call_site_t site;
+    for (auto const& arg : app.args) {
+        auto arg_ = trans_impl(context, *arg, var_env);
+        result_mdp = mdp::mdp_t::merge(std::move(result_mdp), std::move(arg_.mdp));
+        if (arg_.init != at)
+            result_mdp.commands.push_back(make_concat(at, arg_.init));
+        at = arg_.accept;
+        site.args.push_back(arg_.value.expr());
+    }
+    if (at == context.current_location())
+        context.fresh_location();
+
+    // the commands that call and return are added by the `letfun`
+    site.call = at;
+    site.after = context.fresh_location();
+    site.result = context.fresh_var();
+    site.recursive = f.in_body;
+    site.tail = site.recursive && f.tail_calls.count(&app);
+    result_mdp.variables.push_back(declare(site.result, f.ret));
+    f.sites.push_back(site);
+
+    return mdp_with_info_t {
+        std::move(result_mdp), init, site.after,
+        value_info_t {
+            site.result, f.ret
+        }
+    };
+}
+
+mdp_with_info_t create_letfun_case(translation_context_t& context, ast::letfun_expr_t const& letfun, var_env_t const& var_env) {
+    auto const& args = letfun.type.args;
+    function_info_t info;
+    analyze(context, info, letfun, var_env);
+
+    // whatever precedes the `letfun` continues at `init`
+    int init = context.fresh_location();
+    info.entry = context.fresh_location();
+
+    // parameters get fresh variables, as they may shadow a name in scope
+    auto body_env = var_env;
+    std::vector<mdp::variable_t> params;
+    for (size_t i=0; i<args.size(); ++i) {
+        auto param = context.fresh_var();
+        body_env = body_env.append(
+                args[i].name,
+                make<value_info_t>(value_info_t{param, info.params[i]}));
+        params.push_back(declare(param, info.params[i]));
+    }
+
+    context.functions.push_back(&info);
+    info.in_body = true;
+    auto body_ = trans_impl(context, *letfun.init, body_env);
+    info.in_body = false;
+    reserve_accept(context, body_);
+    auto body_vars = body_.mdp.variables;
+    auto in_ = trans_impl(context, *letfun.body, var_env);
+    context.functions.pop_back();
+
+    auto ret_var = "_" + letfun.name + "_ret";
+    auto sp_var = "_" + letfun.name + "_sp";
+    auto result_mdp = mdp::mdp_t::merge(std::move(body_.mdp), std::move(in_.mdp));
+    for (auto const& param : params)
+        result_mdp.variables.push_back(param);
+    int returning = (int)std::count_if(info.sites.begin(), info.sites.end(),
+            [](call_site_t const& site) { return !site.tail; });
+    result_mdp.variables.push_back(mdp::variable_t{
+            ret_var, bound_t{0, std::max(returning - 1, 0)}, 0});
+    result_mdp.commands.push_back(make_concat(init, in_.init));
+    result_mdp.commands.push_back(make_concat(info.entry, body_.init));
+
+    // the frame, declared as it is after the merge
+    std::vector<mdp::variable_t> frame;
+    auto slot = [&](std::string const& name, int i) {
+        return format("_{}_{}{}", name, letfun.name, i);
+    };
+    bool recursive = std::any_of(info.sites.begin(), info.sites.end(),
+            [](call_site_t const& site) { return site.recursive && !site.tail; });
+    if (recursive) {
+        std::unordered_set<std::string> names{ret_var};
+        for (auto const& var : body_vars)
+            names.insert(var.name);
+        for (auto const& param : params)
+            names.insert(param.name);
+        names.erase("location");
+        for (auto const& var : result_mdp.variables) {
+            if (names.erase(var.name))
+                frame.push_back(var);
+        }
+        result_mdp.variables.push_back(mdp::variable_t{
+                sp_var, bound_t{0, info.depth - 1}, 0});
+        if (!info.derived)
+            context.undecided_depth.push_back(letfun.name);
+        for (auto const& var : frame) {
+            for (int i=1; i<info.depth; ++i) {
+                auto copy = var;
+                copy.name = slot(var.name, i);
+                result_mdp.variables.push_back(copy);
+            }
+        }
+    }
+    auto saved = [&](std::string const& name, int i) {
+        return make<mdp::var_expr_t>(slot(name, i));
+    };
+    auto sp = make<mdp::var_expr_t>(sp_var);
+
+    int s = 0;
+    for (auto const& site : info.sites) {
+        // [] location=call -> 1:location'=entry&params'=args&ret'=s
+        assignments_t call{{"location", make<mdp::int_expr_t>(info.entry)}};
+        for (size_t i=0; i<args.size(); ++i)
+            call.emplace_back(params[i].name, site.args[i]);
+        if (site.tail) {
+            // returns where the running call does
+            result_mdp.commands.push_back(make_step(site.call, nullptr, call));
+            continue;
+        }
+        call.emplace_back(ret_var, make<mdp::int_expr_t>(s));
+        // [] location=accept-of-body & ret=s -> 1:location'=after&result'=value
+        assignments_t ret{
+            {"location", make<mdp::int_expr_t>(site.after)},
+            {site.result, body_.value.expr()}
+        };
+        auto returning = make<mdp::binop_expr_t>(
+                make<mdp::var_expr_t>(ret_var),
+                make<mdp::int_expr_t>(s++),
+                mdp::binop_kind_t::Eq);
+
+        if (!site.recursive) {
+            result_mdp.commands.push_back(make_step(site.call, nullptr, call));
+            result_mdp.commands.push_back(make_step(body_.accept, returning, ret));
+            continue;
+        }
+
+        // the frame moves one place down the stack on a call, and back up
+        // on the return, where the deepest saved frame is reset
+        call.emplace_back(sp_var, make<mdp::binop_expr_t>(sp, make<mdp::int_expr_t>(1), mdp::binop_kind_t::Add));
+        ret.emplace_back(sp_var, make<mdp::binop_expr_t>(sp, make<mdp::int_expr_t>(1), mdp::binop_kind_t::Sub));
+        for (auto const& var : frame) {
+            call.emplace_back(slot(var.name, 1), make<mdp::var_expr_t>(var.name));
+            if (var.name != site.result)
+                ret.emplace_back(var.name, saved(var.name, 1));
+            for (int i=1; i+1<info.depth; ++i) {
+                call.emplace_back(slot(var.name, i + 1), saved(var.name, i));
+                ret.emplace_back(slot(var.name, i), saved(var.name, i + 1));
+            }
+            ptr<mdp::expr_t> reset = var.is_int() ?
+                ptr<mdp::expr_t>{make<mdp::int_expr_t>(var.as_int().init)} :
+                ptr<mdp::expr_t>{make<mdp::bool_expr_t>(var.as_bool().init)};
+            ret.emplace_back(slot(var.name, info.depth - 1), reset);
+        }
+        auto has_room = make<mdp::binop_expr_t>(
+                sp, make<mdp::int_expr_t>(info.depth - 1), mdp::binop_kind_t::Lt);
+        result_mdp.commands.push_back(make_step(site.call, has_room, call));
+        if (!context.overflow)
+            context.overflow = context.fresh_location();
+        result_mdp.commands.push_back(make_concat_with_cond(site.call, *context.overflow, make<mdp::neg_expr_t>(has_room)));
+        result_mdp.commands.push_back(make_step(body_.accept, returning, ret));
+    }
+
+    return mdp_with_info_t {
+        std::move(result_mdp), init, in_.accept,
+        in_.value
+    };
+}
+
+mdp_with_info_t trans_impl(translation_context_t& context, ast::expr_t const& e, var_env_t const& var_env) {
     using namespace ast;
     switch (e.kind()) {
     case expr_kind_t::Let:
         return create_let_case(
+                context,
                 cast<ast::let_expr_t>(e).name,
                 *cast<ast::let_expr_t>(e).init,
                 *cast<ast::let_expr_t>(e).body,
                 var_env);
+    case expr_kind_t::LetFun:
+        return create_letfun_case(context, cast<letfun_expr_t>(e), var_env);
+    case expr_kind_t::App:
+        return create_app_case(context, cast<app_expr_t>(e), var_env);
     case expr_kind_t::If:
         return create_if_case(
+                context,
                 *cast<if_expr_t>(e).cond_expr,
                 *cast<if_expr_t>(e).true_expr,
                 *cast<if_expr_t>(e).false_expr,
                 var_env);
     case expr_kind_t::Rand:
         return create_rand_case(
+                context,
                 cast<rand_expr_t>(e).start,
                 cast<rand_expr_t>(e).end);
     case expr_kind_t::Add: case expr_kind_t::Sub:
@@ -417,35 +1218,764 @@ mdp_with_info_t trans_impl(ast::expr_t const& e, var_env_t const& var_env) {
     case expr_kind_t::Leq: case expr_kind_t::Geq:
     case expr_kind_t::And: case expr_kind_t::Or:
         return create_binop_case(
+                context,
                 *cast<ast::binop_expr_t>(e).lhs,
                 *cast<ast::binop_expr_t>(e).rhs,
                 e.kind(), var_env);
     case expr_kind_t::Neg:
-        return create_neg_case(*cast<ast::neg_expr_t>(e).inner, var_env);
+        return create_neg_case(context, *cast<ast::neg_expr_t>(e).inner, var_env);
     case expr_kind_t::Int:
-        return create_int_case(cast<ast::int_expr_t>(e).n);
+        return create_int_case(context, cast<ast::int_expr_t>(e).n);
     case expr_kind_t::Bool:
-        return create_bool_case(cast<ast::bool_expr_t>(e).b);
+        return create_bool_case(context, cast<ast::bool_expr_t>(e).b);
     case expr_kind_t::Var:
-        return create_var_case(cast<ast::var_expr_t>(e).name, var_env);
+        return create_var_case(context, cast<ast::var_expr_t>(e).name, var_env);
     case expr_kind_t::Typed:
-        return trans_impl(*cast<typed_expr_t>(e).expr, var_env);
+        return trans_impl(context, *cast<typed_expr_t>(e).expr, var_env);
     default:
         throw std::logic_error{"unimplemented translation"};
     }
 }
 
-mdp_with_info_t translate_to_mdp(ast::expr_t const& e) {
-    translation_data::init();
-    auto mdp_with_info = trans_impl(e, var_env_t{});
-    for (auto&& var : mdp_with_info.mdp.variables) {
-        if (var.name == "location") {
-            var = mdp::variable_t{
-                "location",
-                bound_t{0, mdp_with_info.accept}, 0};
+mdp_with_info_t translate_to_mdp(ast::expr_t const& e, int max_depth) {
+    translation_context_t context;
+    context.max_depth = max_depth;
+    auto mdp_with_info = trans_impl(context, e, var_env_t{});
+    mdp_with_info.overflow = context.overflow;
+    mdp_with_info.undecided_depth = context.undecided_depth;
+    auto& variables = mdp_with_info.mdp.variables;
+    // functions are translated before the expression that calls them, and
+    // stack overflows end in a location of their own
+    auto location = mdp::variable_t{
+        "location",
+        bound_t{0, std::max(mdp_with_info.accept, context.current_location() - 1)},
+        mdp_with_info.init};
+    auto found = std::find_if(
+            variables.begin(), variables.end(),
+            [](mdp::variable_t const& var) {
+                return var.name == "location";
+            });
+    // commands dispatch on `location` even if no `rand` declared it
+    if (found != variables.end())
+        *found = location;
+    else if (!mdp_with_info.mdp.commands.empty())
+        variables.insert(variables.begin(), location);
+    return mdp_with_info;
+}
+
+
+
+// replaces every name by the expression `f(name)`, or keeps it if that is null
+template<typename F>
+static ptr<mdp::expr_t> substitute(
+        ptr<mdp::expr_t> const& e,
+        F const& f) {
+    using mdp::expr_kind_t;
+    switch (e->kind()) {
+    case expr_kind_t::Int: case expr_kind_t::Real: case expr_kind_t::Bool:
+        return e;
+    case expr_kind_t::Var: {
+        auto value = f(mdp::cast<mdp::var_expr_t>(*e).name);
+        return value ? value : e;
         }
+    case expr_kind_t::Neg:
+        return make<mdp::neg_expr_t>(substitute(mdp::cast<mdp::neg_expr_t>(*e).inner, f));
+    case expr_kind_t::BinOp: {
+        auto const& binop = mdp::cast<mdp::binop_expr_t>(*e);
+        return make<mdp::binop_expr_t>(
+                substitute(binop.lhs, f),
+                substitute(binop.rhs, f),
+                binop.binop_kind);
+        }
+    default:
+        throw std::logic_error{"unexpected expression in a translated command"};
+    }
+}
+
+// replaces every name by `f(name)`
+template<typename F>
+static ptr<mdp::expr_t> map_names(
+        ptr<mdp::expr_t> const& e,
+        F const& f) {
+    return substitute(e, [&](std::string const& name) -> ptr<mdp::expr_t> {
+        auto renamed = f(name);
+        if (renamed == name)
+            return nullptr;
+        return make<mdp::var_expr_t>(renamed);
+    });
+}
+
+// the formulas of a model by name, and what each reads through others
+struct formula_table_t {
+    std::unordered_map<std::string, ptr<mdp::expr_t>> values;
+
+    explicit formula_table_t(mdp_t const& mdp) {
+        for (auto const& formula : mdp.formulas)
+            values.emplace(formula.name, formula.value);
+    }
+
+    bool contains(std::string const& name) const {
+        return values.count(name) > 0;
+    }
+    // the names other than formulas that `formula` reads
+    std::unordered_set<std::string> const& reads(std::string const& formula) const {
+        auto found = cache.find(formula);
+        if (found != cache.end())
+            return found->second;
+        std::unordered_set<std::string> result;
+        map_names(values.at(formula), [&](std::string const& name) {
+            if (contains(name)) {
+                auto const& inner = reads(name);
+                result.insert(inner.begin(), inner.end());
+            } else
+                result.insert(name);
+            return name;
+        });
+        return cache.emplace(formula, std::move(result)).first->second;
+    }
+private:
+    mutable std::unordered_map<std::string, std::unordered_set<std::string>> cache;
+};
+
+// `first` followed by `second` as one simultaneous update
+static assignments_t compose(
+        assignments_t const& first, assignments_t const& second,
+        formula_table_t const& formulas) {
+    std::unordered_map<std::string, ptr<mdp::expr_t>> values;
+    std::unordered_set<std::string> overwritten;
+    for (auto const& assignment : first)
+        values.emplace(assignment.first, assignment.second);
+    for (auto const& assignment : second)
+        overwritten.insert(assignment.first);
+
+    assignments_t result;
+    for (auto const& assignment : first) {
+        if (!overwritten.count(assignment.first))
+            result.push_back(assignment);
+    }
+    // a formula that reads an assigned variable is written out instead
+    std::function<ptr<mdp::expr_t>(std::string const&)> value_of = [&](std::string const& name) -> ptr<mdp::expr_t> {
+        auto found = values.find(name);
+        if (found != values.end())
+            return found->second;
+        if (!formulas.contains(name))
+            return nullptr;
+        auto const& reads = formulas.reads(name);
+        bool stale = std::any_of(reads.begin(), reads.end(),
+                [&](std::string const& read) { return values.count(read) > 0; });
+        if (!stale)
+            return nullptr;
+        return substitute(formulas.values.at(name), value_of);
+    };
+    for (auto const& assignment : second) {
+        if (assignment.first == "location")
+            result.insert(result.begin(), assignment);
+        else
+            result.emplace_back(assignment.first, substitute(assignment.second, value_of));
+    }
+    return result;
+}
+
+static ptr<mdp::expr_t> relocate_guard(ptr<mdp::expr_t> const& guard, std::map<int, int> const& renumber) {
+    if (guard->kind() != mdp::expr_kind_t::BinOp)
+        return guard;
+    auto const& binop = mdp::cast<mdp::binop_expr_t>(*guard);
+    if (binop.binop_kind == mdp::binop_kind_t::And) {
+        return make<mdp::binop_expr_t>(
+                relocate_guard(binop.lhs, renumber),
+                relocate_guard(binop.rhs, renumber),
+                binop.binop_kind);
+    }
+    auto loc = mdp::guard_location(*guard);
+    if (!loc)
+        return guard;
+    return make<mdp::binop_expr_t>(
+            make<mdp::var_expr_t>("location"),
+            make<mdp::int_expr_t>(renumber.at(*loc)),
+            mdp::binop_kind_t::Eq);
+}
+
+void fuse_deterministic_chains(mdp_with_info_t& m) {
+    auto& commands = m.mdp.commands;
+    auto index = m.mdp.index_commands();
+    if (commands.empty() || !index.unlocated.empty())
+        return;
+
+    formula_table_t formulas{m.mdp};
+
+    std::vector<std::vector<assignments_t>> updates(commands.size());
+    // the only command that moves to a location, -1 if none, -2 if several
+    std::unordered_map<int, long> source;
+    for (size_t i=0; i<commands.size(); ++i) {
+        for (auto const& branch : commands[i].branches) {
+            updates[i].emplace_back();
+            split_update(*branch.update, updates[i].back());
+            auto found = source.emplace(target_location(updates[i].back()), (long)i);
+            if (!found.second && found.first->second != (long)i)
+                found.first->second = -2;
+        }
+    }
+
+    // the command at `loc` if it is the only one there and always moves on
+    // with probability 1
+    auto step_at = [&](int loc) -> long {
+        if (loc == m.init || loc == m.accept)
+            return -1;
+        auto found = index.by_location.find(loc);
+        if (found == index.by_location.end() || found->second.size() != 1)
+            return -1;
+        auto i = found->second[0];
+        auto const& guard = *commands[i].guard;
+        if (guard.kind() != mdp::expr_kind_t::BinOp ||
+                mdp::cast<mdp::binop_expr_t>(guard).binop_kind != mdp::binop_kind_t::Eq)
+            return -1;
+        if (commands[i].branches.size() != 1 ||
+                commands[i].branches[0].prob->kind() != mdp::expr_kind_t::Int ||
+                mdp::cast<mdp::int_expr_t>(*commands[i].branches[0].prob).n != 1)
+            return -1;
+        if (target_location(updates[i][0]) == loc)
+            return -1;
+        return (long)i;
+    };
+
+    std::vector<bool> dead(commands.size(), false);
+    for (size_t i=0; i<commands.size(); ++i) {
+        for (bool changed = !dead[i]; changed; ) {
+            changed = false;
+            for (size_t j=0; j<updates[i].size(); ++j) {
+                int to = target_location(updates[i][j]);
+                auto next = step_at(to);
+                if (next < 0 || (size_t)next == i || dead[next] || source[to] != (long)i)
+                    continue;
+                // every branch of `i` that moves to `to` takes the step at once
+                auto const& step = updates[next][0];
+                for (auto& update : updates[i]) {
+                    if (target_location(update) == to)
+                        update = compose(update, step, formulas);
+                }
+                dead[next] = true;
+                source.erase(to);
+                auto& after = source[target_location(step)];
+                after = after == next ? (long)i : after == (long)i ? after : -2;
+                changed = true;
+            }
+        }
+    }
+
+    // locations are renumbered densely, keeping their order
+    std::map<int, int> renumber{{m.init, 0}, {m.accept, 0}};
+    if (m.overflow)
+        renumber.emplace(*m.overflow, 0);
+    for (size_t i=0; i<commands.size(); ++i) {
+        if (dead[i])
+            continue;
+        renumber.emplace(*mdp::guard_location(*commands[i].guard), 0);
+        for (auto const& update : updates[i])
+            renumber.emplace(target_location(update), 0);
+    }
+    int count = 0;
+    for (auto& p : renumber)
+        p.second = count++;
+
+    std::vector<mdp::command_t> fused;
+    for (size_t i=0; i<commands.size(); ++i) {
+        if (dead[i])
+            continue;
+        mdp::command_t command{relocate_guard(commands[i].guard, renumber), {}};
+        for (size_t j=0; j<updates[i].size(); ++j) {
+            auto update = updates[i][j];
+            for (auto& assignment : update) {
+                if (assignment.first == "location")
+                    assignment.second = make<mdp::int_expr_t>(renumber.at(target_location(update)));
+            }
+            command.branches.push_back(mdp::branch_t{commands[i].branches[j].prob, join_update(update)});
+        }
+        fused.push_back(std::move(command));
+    }
+    commands = std::move(fused);
+    m.init = renumber.at(m.init);
+    m.accept = renumber.at(m.accept);
+    if (m.overflow)
+        m.overflow = renumber.at(*m.overflow);
+    for (auto& var : m.mdp.variables) {
+        if (var.name == "location" && var.is_int())
+            var = mdp::variable_t{"location", bound_t{0, count - 1}, m.init};
     }
-    return mdp_with_info;
 }
 
+void reuse_dead_variables(mdp_with_info_t& m, std::unordered_set<std::string> const& observed) {
+    auto& commands = m.mdp.commands;
+    auto& variables = m.mdp.variables;
+    if (commands.empty() || !m.mdp.index_commands().unlocated.empty())
+        return;
+
+    std::unordered_map<std::string, size_t> var_id;
+    for (size_t v=0; v<variables.size(); ++v) {
+        if (variables[v].name != "location")
+            var_id.emplace(variables[v].name, v);
+    }
+    size_t n = variables.size();
+    formula_table_t formulas{m.mdp};
+
+    // formulas read the variables they are over
+    auto read = [&](std::vector<size_t>& reads, std::string const& name) {
+        auto found = var_id.find(name);
+        if (found != var_id.end())
+            reads.push_back(found->second);
+        if (formulas.contains(name)) {
+            for (auto const& inner : formulas.reads(name)) {
+                found = var_id.find(inner);
+                if (found != var_id.end())
+                    reads.push_back(found->second);
+            }
+        }
+        return name;
+    };
+    auto expr_reads_of = [&](ptr<mdp::expr_t> const& e) {
+        std::vector<size_t> reads;
+        map_names(e, [&](std::string const& name) { return read(reads, name); });
+        return reads;
+    };
+
+    struct branch_info_t {
+        size_t target;
+        assignments_t update;
+        std::vector<size_t> reads;  // of the probability
+        std::vector<util::optional<size_t>> writes;
+        std::vector<std::vector<size_t>> value_reads;
+    };
+    struct command_info_t {
+        size_t location;
+        std::vector<size_t> reads;  // of the guard
+        std::vector<branch_info_t> branches;
+    };
+
+    std::unordered_map<int, size_t> locations;
+    auto location_id = [&](int loc) {
+        return locations.emplace(loc, locations.size()).first->second;
+    };
+    auto init = location_id(m.init);
+    auto accept = location_id(m.accept);
+    std::vector<command_info_t> infos;
+    for (auto const& command : commands) {
+        command_info_t info{
+            location_id(*mdp::guard_location(*command.guard)),
+            expr_reads_of(command.guard), {}};
+        for (auto const& branch : command.branches) {
+            branch_info_t b{0, {}, expr_reads_of(branch.prob), {}, {}};
+            split_update(*branch.update, b.update);
+            b.target = location_id(target_location(b.update));
+            for (auto const& assignment : b.update) {
+                auto found = var_id.find(assignment.first);
+                b.writes.push_back(found != var_id.end() ?
+                        util::optional<size_t>{found->second} : util::nullopt);
+                b.value_reads.push_back(expr_reads_of(assignment.second));
+            }
+            info.branches.push_back(std::move(b));
+        }
+        infos.push_back(std::move(info));
+    }
+
+    // variables that may be read later, before they are written again;
+    // a value only counts as read if the variable it is assigned to is live
+    std::vector<std::vector<bool>> live(locations.size(), std::vector<bool>(n, false));
+    for (auto v : expr_reads_of(m.value.expr()))
+        live[accept][v] = true;
+    for (auto const& name : observed) {
+        std::vector<size_t> reads;
+        read(reads, name);
+        for (auto v : reads)
+            live[accept][v] = true;
+    }
+    for (bool changed = true; changed; ) {
+        changed = false;
+        auto add = [&](std::vector<bool>& set, size_t v) {
+            if (!set[v])
+                set[v] = changed = true;
+        };
+        for (auto it = infos.rbegin(); it != infos.rend(); ++it) {
+            auto& in = live[it->location];
+            for (auto v : it->reads)
+                add(in, v);
+            for (auto const& b : it->branches) {
+                auto const& out = live[b.target];
+                for (auto v : b.reads)
+                    add(in, v);
+                std::vector<bool> written(n, false);
+                for (size_t k=0; k<b.update.size(); ++k) {
+                    if (!b.writes[k] || !out[*b.writes[k]])
+                        continue;
+                    written[*b.writes[k]] = true;
+                    for (auto v : b.value_reads[k])
+                        add(in, v);
+                }
+                for (size_t v=0; v<n; ++v) {
+                    if (out[v] && !written[v])
+                        add(in, v);
+                }
+            }
+        }
+    }
+
+    // greedy slot assignment: a variable joins the first slot of its kind
+    // that is not live anywhere it is; variables live at the initial
+    // location, and those the property reads, keep their own slot and value
+    struct slot_t {
+        size_t representative;
+        bool pinned;
+        bound_t bound;
+        std::unordered_set<size_t> occupied;
+    };
+    std::vector<slot_t> slots;
+    std::vector<util::optional<size_t>> slot_of(n);
+    std::vector<std::vector<size_t>> live_at(n);
+    for (size_t l=0; l<locations.size(); ++l) {
+        for (size_t v=0; v<n; ++v) {
+            if (live[l][v])
+                live_at[v].push_back(l);
+        }
+    }
+    for (size_t v=0; v<n; ++v) {
+        if (!var_id.count(variables[v].name) || live_at[v].empty())
+            continue; // `location`, or never read
+        auto bound = variables[v].is_int() ? variables[v].as_int().bound : bound_t{0, 1};
+        bool pinned = live[init][v] || observed.count(variables[v].name);
+        if (!pinned) {
+            for (size_t s=0; s<slots.size() && !slot_of[v]; ++s) {
+                auto& slot = slots[s];
+                if (slot.pinned || variables[slot.representative].is_int() != variables[v].is_int())
+                    continue;
+                bool overlaps = std::any_of(live_at[v].begin(), live_at[v].end(),
+                        [&](size_t l) { return slot.occupied.count(l) > 0; });
+                if (overlaps)
+                    continue;
+                slot_of[v] = s;
+                slot.bound = slot.bound | bound;
+                slot.occupied.insert(live_at[v].begin(), live_at[v].end());
+            }
+        }
+        if (!slot_of[v]) {
+            slot_of[v] = slots.size();
+            slots.push_back(slot_t{v, pinned, bound,
+                    std::unordered_set<size_t>(live_at[v].begin(), live_at[v].end())});
+        }
+    }
+
+    auto rename = [&](std::string const& name) {
+        auto found = var_id.find(name);
+        if (found == var_id.end() || !slot_of[found->second])
+            return name;
+        return variables[slots[*slot_of[found->second]].representative].name;
+    };
+    auto initial_value = [&](slot_t const& slot) -> ptr<mdp::expr_t> {
+        auto const& var = variables[slot.representative];
+        if (var.is_bool())
+            return make<mdp::bool_expr_t>(slot.pinned && var.as_bool().init);
+        return make<mdp::int_expr_t>(slot.pinned ? var.as_int().init : slot.bound.min);
+    };
+    std::vector<std::vector<bool>> live_slots(locations.size(), std::vector<bool>(slots.size()));
+    for (size_t v=0; v<n; ++v) {
+        for (auto l : live_at[v])
+            live_slots[l][*slot_of[v]] = true;
+    }
 
+    // dead assignments are dropped, and a slot is reset to its initial
+    // value on the step where it dies, so dead slots never tell states apart
+    for (size_t i=0; i<commands.size(); ++i) {
+        auto const& info = infos[i];
+        mdp::command_t command{map_names(commands[i].guard, rename), {}};
+        for (size_t j=0; j<info.branches.size(); ++j) {
+            auto const& b = info.branches[j];
+            assignments_t update;
+            for (size_t k=0; k<b.update.size(); ++k) {
+                if (!b.writes[k])
+                    update.push_back(b.update[k]);
+                else if (live[b.target][*b.writes[k]])
+                    update.emplace_back(rename(b.update[k].first), map_names(b.update[k].second, rename));
+            }
+            for (size_t s=0; s<slots.size(); ++s) {
+                if (live_slots[info.location][s] && !live_slots[b.target][s])
+                    update.emplace_back(variables[slots[s].representative].name, initial_value(slots[s]));
+            }
+            command.branches.push_back(mdp::branch_t{
+                    map_names(commands[i].branches[j].prob, rename),
+                    join_update(update)});
+        }
+        commands[i] = std::move(command);
+    }
+    if (!m.value.literal)
+        m.value.name = rename(m.value.name);
+
+    // formulas are renamed alike, and dropped once nothing reads them, as
+    // they may be over variables that are dropped
+    std::unordered_set<std::string> used;
+    std::function<std::string(std::string const&)> use = [&](std::string const& name) {
+        if (formulas.contains(name) && used.insert(name).second)
+            map_names(formulas.values.at(name), use);
+        return name;
+    };
+    for (auto const& command : commands) {
+        map_names(command.guard, use);
+        for (auto const& branch : command.branches) {
+            map_names(branch.prob, use);
+            map_names(branch.update, use);
+        }
+    }
+    map_names(m.value.expr(), use);
+    std::vector<mdp::formula_t> kept;
+    for (auto const& formula : m.mdp.formulas) {
+        if (used.count(formula.name))
+            kept.push_back(mdp::formula_t{formula.name, map_names(formula.value, rename)});
+    }
+    m.mdp.formulas = std::move(kept);
+
+    std::vector<mdp::variable_t> declared;
+    for (size_t v=0; v<n; ++v) {
+        if (!var_id.count(variables[v].name)) {
+            declared.push_back(variables[v]);
+            continue;
+        }
+        if (!slot_of[v] || slots[*slot_of[v]].representative != v)
+            continue;
+        auto const& slot = slots[*slot_of[v]];
+        if (slot.pinned)
+            declared.push_back(variables[v]);
+        else if (variables[v].is_bool())
+            declared.push_back(mdp::variable_t{variables[v].name, false});
+        else
+            declared.push_back(mdp::variable_t{variables[v].name, slot.bound, slot.bound.min});
+    }
+    variables = std::move(declared);
+}
+
+namespace {
+
+// `variable op value`
+struct atom_t {
+    mdp::binop_kind_t op;
+    int value;
+
+    bool holds(int x) const {
+        switch (op) {
+        case mdp::binop_kind_t::Lt: return x < value;
+        case mdp::binop_kind_t::Leq: return x <= value;
+        case mdp::binop_kind_t::Geq: return x >= value;
+        case mdp::binop_kind_t::Gt: return x > value;
+        case mdp::binop_kind_t::Eq: return x == value;
+        case mdp::binop_kind_t::Neq: return x != value;
+        default: throw std::logic_error{"not a comparison"};
+        }
+    }
+};
+
+// how the variables of a model are read: only through comparisons with
+// constants (`atoms`), or in any other way (`opaque`)
+struct observations_t {
+    std::unordered_set<std::string> variables;
+    std::unordered_map<std::string, int> constants;
+    std::unordered_map<std::string, ptr<mdp::expr_t>> formulas;
+    std::unordered_map<std::string, std::vector<atom_t>> atoms;
+    std::unordered_set<std::string> opaque;
+
+    // a formula stands for its value
+    ptr<mdp::expr_t> resolve(ptr<mdp::expr_t> const& e) const {
+        if (e->kind() != mdp::expr_kind_t::Var)
+            return e;
+        auto formula = formulas.find(mdp::cast<mdp::var_expr_t>(*e).name);
+        if (formula != formulas.end())
+            return resolve(formula->second);
+        return e;
+    }
+    util::optional<std::string> as_variable(ptr<mdp::expr_t> const& e) const {
+        auto r = resolve(e);
+        if (r->kind() == mdp::expr_kind_t::Var && variables.count(mdp::cast<mdp::var_expr_t>(*r).name))
+            return mdp::cast<mdp::var_expr_t>(*r).name;
+        return util::nullopt;
+    }
+    util::optional<int> as_constant(ptr<mdp::expr_t> const& e) const {
+        auto r = resolve(e);
+        if (r->kind() == mdp::expr_kind_t::Int)
+            return mdp::cast<mdp::int_expr_t>(*r).n;
+        if (r->kind() == mdp::expr_kind_t::Var) {
+            auto found = constants.find(mdp::cast<mdp::var_expr_t>(*r).name);
+            if (found != constants.end())
+                return found->second;
+        }
+        return util::nullopt;
+    }
+
+    void observe(ptr<mdp::expr_t> const& expr) {
+        auto e = resolve(expr);
+        switch (e->kind()) {
+        case mdp::expr_kind_t::Var:
+            if (variables.count(mdp::cast<mdp::var_expr_t>(*e).name))
+                opaque.insert(mdp::cast<mdp::var_expr_t>(*e).name);
+            return;
+        case mdp::expr_kind_t::Neg:
+            observe(mdp::cast<mdp::neg_expr_t>(*e).inner);
+            return;
+        case mdp::expr_kind_t::BinOp: {
+            auto const& binop = mdp::cast<mdp::binop_expr_t>(*e);
+            auto op = binop.binop_kind;
+            using mdp::binop_kind_t;
+            bool comparison =
+                op == binop_kind_t::Lt || op == binop_kind_t::Leq ||
+                op == binop_kind_t::Geq || op == binop_kind_t::Gt ||
+                op == binop_kind_t::Eq || op == binop_kind_t::Neq;
+            if (comparison) {
+                auto lhs = as_variable(binop.lhs), rhs = as_variable(binop.rhs);
+                auto lhs_value = as_constant(binop.lhs), rhs_value = as_constant(binop.rhs);
+                if (lhs && rhs_value) {
+                    atoms[*lhs].push_back(atom_t{op, *rhs_value});
+                    return;
+                }
+                if (rhs && lhs_value) {
+                    auto flipped =
+                        op == binop_kind_t::Lt ? binop_kind_t::Gt :
+                        op == binop_kind_t::Leq ? binop_kind_t::Geq :
+                        op == binop_kind_t::Geq ? binop_kind_t::Leq :
+                        op == binop_kind_t::Gt ? binop_kind_t::Lt : op;
+                    atoms[*rhs].push_back(atom_t{flipped, *lhs_value});
+                    return;
+                }
+            }
+            observe(binop.lhs);
+            observe(binop.rhs);
+            return;
+            }
+        default:
+            return;
+        }
+    }
+};
+
+// `n` or `n/d` as a reduced fraction
+util::optional<std::pair<long long, long long>> as_fraction(observations_t const& obs, ptr<mdp::expr_t> const& e) {
+    if (auto n = obs.as_constant(e))
+        return std::make_pair((long long)*n, 1LL);
+    if (e->kind() != mdp::expr_kind_t::BinOp)
+        return util::nullopt;
+    auto const& binop = mdp::cast<mdp::binop_expr_t>(*e);
+    auto num = obs.as_constant(binop.lhs), den = obs.as_constant(binop.rhs);
+    if (binop.binop_kind != mdp::binop_kind_t::Div || !num || !den || *den <= 0)
+        return util::nullopt;
+    return std::make_pair((long long)*num, (long long)*den);
+}
+
+}
+
+void abstract_rand_branches(mdp_with_info_t& m, std::unordered_set<std::string> const& observed) {
+    observations_t obs;
+    for (auto const& var : m.mdp.variables) {
+        if (var.name != "location")
+            obs.variables.insert(var.name);
+    }
+    for (auto const& cnst : m.mdp.constants)
+        obs.constants.emplace(cnst.name, cnst.is_int() ? cnst.as_int() : (int)cnst.as_bool());
+    for (auto const& formula : m.mdp.formulas)
+        obs.formulas.emplace(formula.name, formula.value);
+    for (auto const& command : m.mdp.commands) {
+        obs.observe(command.guard);
+        for (auto const& branch : command.branches) {
+            obs.observe(branch.prob);
+            assignments_t update;
+            split_update(*branch.update, update);
+            for (auto const& assignment : update)
+                obs.observe(assignment.second);
+        }
+    }
+    obs.observe(m.value.expr());
+    for (auto const& name : observed)
+        obs.observe(make<mdp::var_expr_t>(name));
+
+    for (auto& command : m.mdp.commands) {
+        std::vector<assignments_t> updates;
+        std::vector<std::pair<long long, long long>> probs;
+        for (auto const& branch : command.branches) {
+            auto prob = as_fraction(obs, branch.prob);
+            if (!prob)
+                break;
+            probs.push_back(*prob);
+            updates.emplace_back();
+            split_update(*branch.update, updates.back());
+        }
+        if (probs.size() != command.branches.size() || updates.size() < 2)
+            continue;
+
+        // every outcome of a variable that is only compared with constants
+        // becomes the least outcome that satisfies the same comparisons
+        bool changed = false;
+        for (size_t k=0; k<updates[0].size(); ++k) {
+            auto const& name = updates[0][k].first;
+            if (!obs.variables.count(name) || obs.opaque.count(name))
+                continue;
+            std::vector<int> values;
+            for (auto const& update : updates) {
+                util::optional<int> value;
+                for (auto const& assignment : update) {
+                    if (assignment.first == name)
+                        value = obs.as_constant(assignment.second);
+                }
+                if (!value)
+                    break;
+                values.push_back(*value);
+            }
+            if (values.size() != updates.size())
+                continue;
+            auto const& atoms = obs.atoms[name];
+            std::map<std::vector<bool>, int> representative;
+            for (auto value : values) {
+                std::vector<bool> signature;
+                for (auto const& atom : atoms)
+                    signature.push_back(atom.holds(value));
+                auto found = representative.emplace(signature, value);
+                if (!found.second)
+                    found.first->second = std::min(found.first->second, value);
+            }
+            for (auto& update : updates) {
+                for (auto& assignment : update) {
+                    if (assignment.first != name)
+                        continue;
+                    int value = *obs.as_constant(assignment.second);
+                    std::vector<bool> signature;
+                    for (auto const& atom : atoms)
+                        signature.push_back(atom.holds(value));
+                    int abstracted = representative.at(signature);
+                    changed = changed || abstracted != value;
+                    assignment.second = make<mdp::int_expr_t>(abstracted);
+                }
+            }
+        }
+        if (!changed)
+            continue;
+
+        // branches that now agree are merged and their probabilities added
+        std::vector<std::string> keys;
+        std::vector<mdp::branch_t> branches;
+        std::vector<std::pair<long long, long long>> merged;
+        for (size_t j=0; j<updates.size(); ++j) {
+            auto update = join_update(updates[j]);
+            auto key = format("{}", *update);
+            auto found = std::find(keys.begin(), keys.end(), key);
+            if (found == keys.end()) {
+                keys.push_back(key);
+                branches.push_back(mdp::branch_t{nullptr, update});
+                merged.push_back(probs[j]);
+                continue;
+            }
+            auto& sum = merged[found - keys.begin()];
+            sum = {sum.first * probs[j].second + probs[j].first * sum.second, sum.second * probs[j].second};
+            auto g = std::gcd(sum.first, sum.second);
+            sum = {sum.first / g, sum.second / g};
+        }
+        for (size_t j=0; j<branches.size(); ++j) {
+            branches[j].prob = merged[j].second == 1 ?
+                ptr<mdp::expr_t>{make<mdp::int_expr_t>((int)merged[j].first)} :
+                ptr<mdp::expr_t>{make<mdp::binop_expr_t>(
+                        make<mdp::int_expr_t>((int)merged[j].first),
+                        make<mdp::int_expr_t>((int)merged[j].second),
+                        mdp::binop_kind_t::Div)};
+        }
+        command.branches = std::move(branches);
+    }
+}
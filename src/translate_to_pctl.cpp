@@ -5,13 +5,26 @@
 
 pctl::pctl_t translate_to_pctl(ast::refinement_type_t const& ty, mdp_with_info_t const& mdp_with_info) {
     using namespace logic;
-    auto const& arg = mdp_with_info.value.name;
-    auto formula = ty.domain == domain_kind_t::Int ?
-        subst(ty.constraint, ty.name, make<var_term_t>(arg)) :
-        subst(ty.constraint, ty.name, make<var_formula_t>(arg));
+    auto const& value = mdp_with_info.value;
+    ptr<formula_t> formula;
+    if (ty.domain == domain_kind_t::Int) {
+        ptr<term_t> term = make<var_term_t>(value.name);
+        if (value.literal)
+            term = make<int_term_t>(mdp::cast<mdp::int_expr_t>(*value.literal).n);
+        formula = subst(ty.constraint, ty.name, term);
+    } else {
+        ptr<formula_t> inner = make<var_formula_t>(value.name);
+        if (value.literal && mdp::cast<mdp::bool_expr_t>(*value.literal).b)
+            inner = make<top_formula_t>();
+        else if (value.literal)
+            inner = make<bot_formula_t>();
+        formula = subst(ty.constraint, ty.name, inner);
+    }
     return pctl::pctl_t {
         mdp_with_info.accept,
-        formula
+        formula,
+        mdp::is_deterministic(mdp_with_info.mdp),
+        mdp_with_info.overflow
     };
 }
 
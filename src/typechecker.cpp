@@ -1,6 +1,7 @@
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
+#include <algorithm>
 
 #include "environment.hpp"
 #include "expr_ast.hpp"
@@ -8,7 +9,9 @@
 #include "typechecker.hpp"
 #include "translate.hpp"
 #include "MDP.hpp"
+#include "mdp_compile.hpp"
 #include "PCTL.hpp"
+#include "checker.hpp"
 
 // TODO: output to temporary files
 bool check_by_PRISM(mdp::mdp_t const& mdp, pctl::pctl_t const& pctl) {
@@ -35,73 +38,194 @@ bool check_by_PRISM(mdp::mdp_t const& mdp, pctl::pctl_t const& pctl) {
     return false;
 }
 
-bool model_checking(ast::expr_t const& expr, ast::refinement_type_t const& type) {
+bool model_checking(
+        ast::expr_t const& expr,
+        ast::refinement_type_t const& type,
+        checker::options_t const& options) {
     std::cout << "    converting the program to MDP .. " << std::flush;
-    auto mdp_with_info = translate_to_mdp(expr);
+    auto mdp_with_info = translate_to_mdp(expr, options.max_depth);
+    // the variables of the program that the property reads besides the value
+    auto observed = logic::free_variables(*type.constraint);
+    observed.erase(type.name);
+    fuse_deterministic_chains(mdp_with_info);
+    abstract_rand_branches(mdp_with_info, observed);
+    reuse_dead_variables(mdp_with_info, observed);
     std::cout << "done!" << std::endl;
+    for (auto const& name : mdp_with_info.undecided_depth) {
+        std::cout << "    the stack depth of " << name << " is not derived from its arguments; "
+            "calls deeper than --max-depth=" << options.max_depth << " count against the property" << std::endl;
+    }
     std::cout << "    converting the type to PCTL .. " << std::flush;
     auto pctl = translate_to_pctl(type, mdp_with_info);
     std::cout << "done!" << std::endl;
-    std::cout << "    checking with PRISM .. " << std::flush;
-    auto result = check_by_PRISM(mdp_with_info.mdp, pctl);
+    bool result;
+    if (options.engine != checker::engine_t::Prism) {
+        std::cout << "    checking in-process .. " << std::flush;
+        auto verdict = checker::check(mdp_with_info.mdp, pctl, options);
+        if (verdict == checker::verdict_t::Unknown)
+            std::cout << "undecided within precision " << options.precision << " .. " << std::flush;
+        result = verdict == checker::verdict_t::True;
+    } else {
+        std::cout << "    checking with PRISM .. " << std::flush;
+        mdp::order_variables(mdp_with_info.mdp);
+        result = check_by_PRISM(mdp_with_info.mdp, pctl);
+    }
     std::cout << "done!" << std::endl;
     return result;
 }
 
 using env_t = environment_t<ast::expr_t>;
 
+// functions are bound to their `letfun`, whose body is replaced
 ptr<ast::expr_t> add_bindings(ptr<ast::expr_t> const& expr, env_t const& env) {
     auto acc = expr;
     auto const& maps = env.elems;
-    for (auto it = maps.rbegin(); it != maps.rend(); ++it)
-        acc = make<ast::let_expr_t>(it->first, it->second, acc);
+    for (auto it = maps.rbegin(); it != maps.rend(); ++it) {
+        if (it->second->kind() == ast::expr_kind_t::LetFun) {
+            auto const& letfun = ast::cast<ast::letfun_expr_t>(*it->second);
+            acc = make<ast::letfun_expr_t>(it->first, letfun.type, letfun.init, acc);
+        } else {
+            acc = make<ast::let_expr_t>(it->first, it->second, acc);
+        }
+    }
     return acc;
 }
 
-namespace typechecker {
+// the return type of a call, with the parameters it refers to replaced by
+// the arguments, which have to be literals then
+ast::refinement_type_t return_type(ast::dependent_type_t const& type, std::vector<ptr<ast::expr_t>> const& args) {
+    auto result = type.ret_type;
+    for (size_t i=0; i<args.size(); ++i) {
+        auto const& name = type.args[i].name;
+        auto const& arg = *args[i];
+        ptr<logic::formula_t> constraint;
+        if (arg.kind() == ast::expr_kind_t::Int)
+            constraint = logic::subst(result.constraint, name, make<logic::int_term_t>(ast::cast<ast::int_expr_t>(arg).n));
+        else if (arg.kind() == ast::expr_kind_t::Bool && ast::cast<ast::bool_expr_t>(arg).b)
+            constraint = logic::subst(result.constraint, name, make<logic::top_formula_t>());
+        else if (arg.kind() == ast::expr_kind_t::Bool)
+            constraint = logic::subst(result.constraint, name, make<logic::bot_formula_t>());
+        else if (*logic::subst(result.constraint, name, make<logic::int_term_t>(0)) != *result.constraint)
+            throw std::runtime_error{"the return type depends on the non-literal argument " + name};
+        if (constraint)
+            result.constraint = constraint;
+    }
+    return result;
+}
 
-bool typecheck(ast::expr_t const& expr, env_t const& env) {
+// whether `expr` contains an `e : type` annotation
+bool has_annotation(ast::expr_t const& expr) {
     using namespace ast;
     switch (expr.kind()) {
+    case expr_kind_t::Typed:
+        return true;
+    case expr_kind_t::Let:
+        return
+            has_annotation(*cast<let_expr_t>(expr).init) ||
+            has_annotation(*cast<let_expr_t>(expr).body);
     case expr_kind_t::LetFun:
-    case expr_kind_t::App:
-        throw std::runtime_error{"unimplemented yet"};
+        return
+            has_annotation(*cast<letfun_expr_t>(expr).init) ||
+            has_annotation(*cast<letfun_expr_t>(expr).body);
+    case expr_kind_t::App: {
+        auto const& app = cast<app_expr_t>(expr);
+        return has_annotation(*app.f) || std::any_of(app.args.begin(), app.args.end(),
+                [](ptr<expr_t> const& arg) { return has_annotation(*arg); });
+        }
+    case expr_kind_t::If:
+        return
+            has_annotation(*cast<if_expr_t>(expr).cond_expr) ||
+            has_annotation(*cast<if_expr_t>(expr).true_expr) ||
+            has_annotation(*cast<if_expr_t>(expr).false_expr);
+    case expr_kind_t::Neg:
+        return has_annotation(*cast<neg_expr_t>(expr).inner);
+    case expr_kind_t::Add: case expr_kind_t::Sub:
+    case expr_kind_t::Mul: case expr_kind_t::Div:
+    case expr_kind_t::Eq: case expr_kind_t::Neq:
+    case expr_kind_t::Leq: case expr_kind_t::Geq:
+    case expr_kind_t::And: case expr_kind_t::Or:
+        return
+            has_annotation(*cast<binop_expr_t>(expr).lhs) ||
+            has_annotation(*cast<binop_expr_t>(expr).rhs);
+    case expr_kind_t::Fun:
+        return has_annotation(*cast<fun_expr_t>(expr).body);
+    case expr_kind_t::Int: case expr_kind_t::Bool:
+    case expr_kind_t::Rand: case expr_kind_t::Var:
+        return false;
+    }
+    throw std::logic_error{"unreachable"};
+}
+
+namespace typechecker {
+
+bool typecheck(ast::expr_t const& expr, env_t const& env, checker::options_t const& options) {
+    using namespace ast;
+    switch (expr.kind()) {
+    case expr_kind_t::LetFun: {
+        // the body is checked through the return type at each call, which
+        // says nothing about the values of an annotation within the body
+        auto const& letfun = cast<letfun_expr_t>(expr);
+        if (has_annotation(*letfun.init))
+            throw std::runtime_error{"type annotations in the body of function " + letfun.name + " are not supported"};
+        auto new_env = env.append(letfun.name, make<letfun_expr_t>(letfun));
+        return typecheck(*letfun.body, new_env, options);
+        }
+    case expr_kind_t::App: {
+        auto const& app = cast<app_expr_t>(expr);
+        for (auto const& arg : app.args) {
+            if (!typecheck(*arg, env, options))
+                return false;
+        }
+        if (app.f->kind() != expr_kind_t::Var)
+            throw std::runtime_error{"unimplemented yet"};
+        auto f = env.lookup(cast<var_expr_t>(*app.f).name);
+        if (!f || f->kind() != expr_kind_t::LetFun)
+            throw std::runtime_error{"unimplemented yet"};
+        auto const& type = cast<letfun_expr_t>(*f).type;
+        if (type.ret_type.constraint->kind() == logic::formula_kind_t::Top)
+            return true;
+        return model_checking(
+                *add_bindings(make<app_expr_t>(app.f, app.args), env),
+                return_type(type, app.args),
+                options);
+        }
     case expr_kind_t::Typed:
         return model_checking(
                 *add_bindings(cast<typed_expr_t>(expr).expr, env),
-                cast<typed_expr_t>(expr).type);
+                cast<typed_expr_t>(expr).type,
+                options);
     case expr_kind_t::Let: {
         auto init = cast<let_expr_t>(expr).init;
-        if (!typecheck(*init, env))
+        if (!typecheck(*init, env, options))
             return false;
         std::string name = cast<let_expr_t>(expr).name;
         auto new_env = env.append(name, init);
         auto body = cast<let_expr_t>(expr).body;
-        return typecheck(*body, new_env);
+        return typecheck(*body, new_env, options);
         }
     case expr_kind_t::If:
         return
-            typecheck(*cast<if_expr_t>(expr).cond_expr, env) &&
-            typecheck(*cast<if_expr_t>(expr).true_expr, env) &&
-            typecheck(*cast<if_expr_t>(expr).false_expr, env);
+            typecheck(*cast<if_expr_t>(expr).cond_expr, env, options) &&
+            typecheck(*cast<if_expr_t>(expr).true_expr, env, options) &&
+            typecheck(*cast<if_expr_t>(expr).false_expr, env, options);
     case expr_kind_t::Neg:
-        return typecheck(*cast<neg_expr_t>(expr).inner, env);
+        return typecheck(*cast<neg_expr_t>(expr).inner, env, options);
     case expr_kind_t::Add: case expr_kind_t::Sub:
     case expr_kind_t::Mul: case expr_kind_t::Div:
     case expr_kind_t::Eq: case expr_kind_t::Neq:
     case expr_kind_t::Leq: case expr_kind_t::Geq:
     case expr_kind_t::And: case expr_kind_t::Or:
         return
-            typecheck(*cast<binop_expr_t>(expr).lhs, env) &&
-            typecheck(*cast<binop_expr_t>(expr).rhs, env);
+            typecheck(*cast<binop_expr_t>(expr).lhs, env, options) &&
+            typecheck(*cast<binop_expr_t>(expr).rhs, env, options);
     case expr_kind_t::Int: case expr_kind_t::Bool: case expr_kind_t::Fun:
     case expr_kind_t::Rand: case expr_kind_t::Var:
         return true; // primitives
     }
 }
 
-bool typecheck(ast::expr_t const& expr) {
-    return typecheck(expr, env_t{});
+bool typecheck(ast::expr_t const& expr, checker::options_t const& options) {
+    return typecheck(expr, env_t{}, options);
 }
 
 }